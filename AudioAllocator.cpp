@@ -0,0 +1,303 @@
+///
+/// @file AudioAllocator.cpp
+///
+#include "AudioAllocator.h"
+#include <cstdlib>
+#include <cstring>
+#include "Logger.h"
+
+namespace {
+
+const size_t ALIGNMENT = 16;
+const uint16_t LARGE_BLOCK = 0xFFFF;
+// Large blocks are only split when the remainder could hold a useful allocation
+const size_t MIN_SPLIT_BYTES = 64;
+
+size_t alignUp(size_t value) {
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+void raisePeak(std::atomic<size_t>& peak, size_t value) {
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+}
+
+/**
+ * Precedes every block handed to FMOD, keeping the pointer FMOD gets aligned
+ */
+struct AudioAllocator::BlockHeader {
+    uint32_t blockSize;
+    uint32_t requestedSize;
+    uint16_t sizeClass;
+    uint16_t category;
+    uint32_t padding;
+};
+
+/**
+ * Stored in the first bytes of a free block
+ */
+struct AudioAllocator::FreeBlock {
+    size_t size;
+    FreeBlock* next;
+};
+
+const uint32_t AudioAllocator::SIZE_CLASSES[SIZE_CLASS_COUNT] = { 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048 };
+
+AudioAllocator* AudioAllocator::installed = nullptr;
+
+FMOD_RESULT AudioAllocator::install(size_t capacityBytes) {
+    if (installed)
+        return FMOD_ERR_INITIALIZED;
+    // the slice is never freed, FMOD may hold allocations until the process exits
+    capacityBytes &= ~(ALIGNMENT - 1);
+    if (capacityBytes < SLAB_BYTES)
+        return FMOD_ERR_INVALID_PARAM;
+    unsigned char* allocation = static_cast<unsigned char*>(std::malloc(capacityBytes + ALIGNMENT));
+    if (!allocation)
+        return FMOD_ERR_MEMORY;
+    unsigned char* memory = reinterpret_cast<unsigned char*>(alignUp(reinterpret_cast<uintptr_t>(allocation)));
+    AudioAllocator* allocator = new AudioAllocator(memory, capacityBytes);
+    installed = allocator;
+    FMOD_RESULT result = FMOD::Memory_Initialize(nullptr, 0, allocCallback, reallocCallback, freeCallback, FMOD_MEMORY_ALL);
+    if (result != FMOD_OK) {
+        installed = nullptr;
+        delete allocator;
+        std::free(allocation);
+    }
+    return result;
+}
+
+AudioAllocator::AudioAllocator(unsigned char* memory, size_t capacity) : memory(memory), capacity(capacity) {
+    freeList = reinterpret_cast<FreeBlock*>(memory);
+    freeList->size = capacity;
+    freeList->next = nullptr;
+    for (int i = 0; i < AudioMemoryStats::CATEGORY_COUNT; i++) {
+        categoryBytes[i].store(0, std::memory_order_relaxed);
+        categoryPeakBytes[i].store(0, std::memory_order_relaxed);
+        categoryAllocations[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+AudioMemoryStats AudioAllocator::getStats() {
+    AudioMemoryStats stats;
+    AudioAllocator* allocator = installed;
+    if (!allocator)
+        return stats;
+    stats.capacityBytes = allocator->capacity;
+    stats.usedBytes = allocator->usedBytes.load(std::memory_order_relaxed);
+    stats.peakUsedBytes = allocator->peakUsedBytes.load(std::memory_order_relaxed);
+    stats.failedAllocations = allocator->failedAllocations.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(allocator->largeMutex);
+        for (FreeBlock* block = allocator->freeList; block; block = block->next)
+            if (block->size > stats.largestFreeBlock)
+                stats.largestFreeBlock = block->size;
+    }
+    for (int i = 0; i < AudioMemoryStats::CATEGORY_COUNT; i++) {
+        stats.categories[i].currentBytes = allocator->categoryBytes[i].load(std::memory_order_relaxed);
+        stats.categories[i].peakBytes = allocator->categoryPeakBytes[i].load(std::memory_order_relaxed);
+        stats.categories[i].allocations = allocator->categoryAllocations[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void* AudioAllocator::allocate(size_t size, FMOD_MEMORY_TYPE type) {
+    static_assert(sizeof(BlockHeader) == ALIGNMENT, "block header must keep allocations aligned");
+    size_t blockSize = alignUp(size + sizeof(BlockHeader));
+    uint16_t sizeClass = LARGE_BLOCK;
+    for (uint16_t i = 0; i < SIZE_CLASS_COUNT; i++) {
+        if (blockSize <= SIZE_CLASSES[i]) {
+            sizeClass = i;
+            blockSize = SIZE_CLASSES[i];
+            break;
+        }
+    }
+
+    unsigned char* block = nullptr;
+    if (sizeClass != LARGE_BLOCK) {
+        std::lock_guard<std::mutex> lock(classMutexes[sizeClass]);
+        if (!classFreeLists[sizeClass]) {
+            // refill with a slab, or when the slice is too full for one, with just this block
+            size_t slabSize = SLAB_BYTES;
+            unsigned char* slab = allocateLarge(slabSize, true);
+            if (!slab) {
+                slabSize = blockSize;
+                slab = allocateLarge(slabSize, true);
+            }
+            for (size_t offset = 0; slab && offset + blockSize <= slabSize; offset += blockSize) {
+                FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>(slab + offset);
+                freeBlock->next = classFreeLists[sizeClass];
+                classFreeLists[sizeClass] = freeBlock;
+            }
+        }
+        if (FreeBlock* freeBlock = classFreeLists[sizeClass]) {
+            classFreeLists[sizeClass] = freeBlock->next;
+            block = reinterpret_cast<unsigned char*>(freeBlock);
+        }
+    }
+    else if (blockSize <= 0xFFFFFFFFu) // block sizes are stored in 32 bits
+        block = allocateLarge(blockSize);
+
+    if (!block) {
+        if (failedAllocations.fetch_add(1, std::memory_order_relaxed) == 0)
+            AUDIO_LOG_ERROR("AudioAllocator: Out of audio memory, couldn't allocate %zu bytes of the %zu byte slice", size, capacity);
+        return nullptr;
+    }
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+    header->blockSize = uint32_t(blockSize);
+    header->requestedSize = uint32_t(size);
+    header->sizeClass = sizeClass;
+    header->category = uint16_t(categoryOf(type));
+    header->padding = 0;
+    account(header->category, size, true);
+    return block + sizeof(BlockHeader);
+}
+
+void* AudioAllocator::reallocate(void* pointer, size_t size, FMOD_MEMORY_TYPE type) {
+    if (!pointer)
+        return allocate(size, type);
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<unsigned char*>(pointer) - sizeof(BlockHeader));
+    if (size + sizeof(BlockHeader) <= header->blockSize) {
+        // still fits, only the accounting changes
+        account(header->category, header->requestedSize, false);
+        account(header->category, size, true);
+        header->requestedSize = uint32_t(size);
+        return pointer;
+    }
+    void* moved = allocate(size, type);
+    if (!moved)
+        return nullptr; // the original block stays valid, as with realloc()
+    memcpy(moved, pointer, header->requestedSize);
+    release(pointer);
+    return moved;
+}
+
+void AudioAllocator::release(void* pointer) {
+    if (!pointer)
+        return;
+    unsigned char* block = static_cast<unsigned char*>(pointer) - sizeof(BlockHeader);
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+    account(header->category, header->requestedSize, false);
+    uint16_t sizeClass = header->sizeClass;
+    if (sizeClass == LARGE_BLOCK) {
+        releaseLarge(block, header->blockSize);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(classMutexes[sizeClass]);
+    FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>(block);
+    freeBlock->next = classFreeLists[sizeClass];
+    classFreeLists[sizeClass] = freeBlock;
+}
+
+unsigned char* AudioAllocator::allocateLarge(size_t& size, bool fromTop) {
+    std::lock_guard<std::mutex> lock(largeMutex);
+    if (fromTop) {
+        // cut from the end of the highest block that fits
+        FreeBlock** lastLink = nullptr;
+        for (FreeBlock** link = &freeList; *link; link = &(*link)->next)
+            if ((*link)->size >= size)
+                lastLink = link;
+        if (!lastLink)
+            return nullptr;
+        FreeBlock* block = *lastLink;
+        if (block->size - size < MIN_SPLIT_BYTES) {
+            size = block->size;
+            *lastLink = block->next;
+            addUsed(size);
+            return reinterpret_cast<unsigned char*>(block);
+        }
+        block->size -= size;
+        addUsed(size);
+        return reinterpret_cast<unsigned char*>(block) + block->size;
+    }
+    FreeBlock** link = &freeList;
+    for (FreeBlock* block = freeList; block; link = &block->next, block = block->next) {
+        if (block->size < size)
+            continue;
+        if (block->size - size >= MIN_SPLIT_BYTES) {
+            // the remainder takes the block's place in the address ordered list
+            FreeBlock* remainder = reinterpret_cast<FreeBlock*>(reinterpret_cast<unsigned char*>(block) + size);
+            remainder->size = block->size - size;
+            remainder->next = block->next;
+            *link = remainder;
+        }
+        else {
+            size = block->size;
+            *link = block->next;
+        }
+        addUsed(size);
+        return reinterpret_cast<unsigned char*>(block);
+    }
+    return nullptr;
+}
+
+void AudioAllocator::releaseLarge(unsigned char* block, size_t size) {
+    std::lock_guard<std::mutex> lock(largeMutex);
+    usedBytes.fetch_sub(size, std::memory_order_relaxed);
+    FreeBlock* previous = nullptr;
+    FreeBlock* next = freeList;
+    while (next && reinterpret_cast<unsigned char*>(next) < block) {
+        previous = next;
+        next = next->next;
+    }
+    FreeBlock* freed = reinterpret_cast<FreeBlock*>(block);
+    freed->size = size;
+    freed->next = next;
+    if (next && block + size == reinterpret_cast<unsigned char*>(next)) {
+        freed->size += next->size;
+        freed->next = next->next;
+    }
+    if (previous && reinterpret_cast<unsigned char*>(previous) + previous->size == block) {
+        previous->size += freed->size;
+        previous->next = freed->next;
+    }
+    else if (previous)
+        previous->next = freed;
+    else
+        freeList = freed;
+}
+
+void AudioAllocator::addUsed(size_t bytes) {
+    raisePeak(peakUsedBytes, usedBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void AudioAllocator::account(int category, size_t bytes, bool add) {
+    if (add) {
+        raisePeak(categoryPeakBytes[category], categoryBytes[category].fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        categoryAllocations[category].fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        categoryBytes[category].fetch_sub(bytes, std::memory_order_relaxed);
+        categoryAllocations[category].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+int AudioAllocator::categoryOf(FMOD_MEMORY_TYPE type) {
+    if (type & FMOD_MEMORY_STREAM_FILE)
+        return AudioMemoryStats::STREAM_FILE;
+    if (type & FMOD_MEMORY_STREAM_DECODE)
+        return AudioMemoryStats::STREAM_DECODE;
+    if (type & FMOD_MEMORY_SAMPLEDATA)
+        return AudioMemoryStats::SAMPLEDATA;
+    if (type & FMOD_MEMORY_DSP_BUFFER)
+        return AudioMemoryStats::DSP_BUFFER;
+    if (type & FMOD_MEMORY_PLUGIN)
+        return AudioMemoryStats::PLUGIN;
+    if (type & FMOD_MEMORY_PERSISTENT)
+        return AudioMemoryStats::PERSISTENT;
+    return AudioMemoryStats::NORMAL;
+}
+
+void* F_CALL AudioAllocator::allocCallback(unsigned int size, FMOD_MEMORY_TYPE type, const char* /*sourcestr*/) {
+    return installed->allocate(size, type);
+}
+
+void* F_CALL AudioAllocator::reallocCallback(void* ptr, unsigned int size, FMOD_MEMORY_TYPE type, const char* /*sourcestr*/) {
+    return installed->reallocate(ptr, size, type);
+}
+
+void F_CALL AudioAllocator::freeCallback(void* ptr, FMOD_MEMORY_TYPE /*type*/, const char* /*sourcestr*/) {
+    installed->release(ptr);
+}
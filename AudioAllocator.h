@@ -0,0 +1,114 @@
+#pragma once
+///
+/// @file AudioAllocator.h
+///
+/// Allocator FMOD can be given through FMOD::Memory_Initialize(), so audio lives in one fixed slice of
+/// memory instead of the CRT heap. The slice is reserved once, up front. Small allocations come from
+/// per size class free lists, carved out of the slice in slabs, so the many short lived allocations FMOD
+/// makes reuse blocks of the same size instead of fragmenting the heap. Larger allocations come from
+/// the rest of the slice, first fit from an address ordered free list which coalesces neighbouring blocks.
+/// Once the slice is exhausted allocations fail and FMOD reports FMOD_ERR_MEMORY, rather than the
+/// process growing without bound. Usage is accounted per FMOD_MEMORY_TYPE category.
+///
+#include <FMOD/fmod.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Memory use of one FMOD_MEMORY_TYPE category
+ */
+struct AudioMemoryCategoryStats {
+    // bytes FMOD asked for, not including block headers and size class rounding
+    size_t currentBytes = 0;
+    size_t peakBytes = 0;
+    size_t allocations = 0;
+};
+
+/**
+ * Snapshot of the allocator, see AudioAllocator::getStats()
+ */
+struct AudioMemoryStats {
+    enum Category { NORMAL, STREAM_FILE, STREAM_DECODE, SAMPLEDATA, DSP_BUFFER, PLUGIN, PERSISTENT, CATEGORY_COUNT };
+
+    size_t capacityBytes = 0;
+    // bytes of the slice handed out, including headers, rounding and slabs held by the size classes
+    size_t usedBytes = 0;
+    size_t peakUsedBytes = 0;
+    // largest allocation the slice could still satisfy from outside the size classes
+    size_t largestFreeBlock = 0;
+    // allocations refused because the slice was full
+    size_t failedAllocations = 0;
+    AudioMemoryCategoryStats categories[CATEGORY_COUNT];
+};
+
+class AudioAllocator {
+public:
+    /**
+     * Reserves the memory slice and installs the allocator with FMOD::Memory_Initialize(). Must be called
+     * before any FMOD system is created, and only once per process: FMOD can't change allocator afterwards.
+     * @return FMOD_OK, FMOD_ERR_INVALID_PARAM if capacityBytes is smaller than a slab, FMOD_ERR_MEMORY if the
+     * slice couldn't be reserved, or FMOD_ERR_INITIALIZED if the allocator was already installed
+     */
+    static FMOD_RESULT install(size_t capacityBytes);
+
+    static bool isInstalled() { return installed != nullptr; }
+
+    /**
+     * Current usage. Returns empty stats if the allocator isn't installed
+     */
+    static AudioMemoryStats getStats();
+
+private:
+    // Size classes of the small allocations, as block sizes including the header
+    static const size_t SIZE_CLASS_COUNT = 13;
+    static const uint32_t SIZE_CLASSES[SIZE_CLASS_COUNT];
+    // Memory carved from the slice at a time to refill a size class
+    static const size_t SLAB_BYTES = 64 * 1024;
+
+    struct BlockHeader;
+    struct FreeBlock;
+
+    explicit AudioAllocator(unsigned char* memory, size_t capacity);
+
+    void* allocate(size_t size, FMOD_MEMORY_TYPE type);
+    void* reallocate(void* pointer, size_t size, FMOD_MEMORY_TYPE type);
+    void release(void* pointer);
+
+    // Takes a block of at least size bytes from the large block free list, or nullptr if none fits.
+    // size is updated to the size of the block taken, which includes any remainder too small to split off.
+    // Slabs are taken fromTop, keeping them away from the large blocks at the bottom of the slice.
+    unsigned char* allocateLarge(size_t& size, bool fromTop = false);
+    void releaseLarge(unsigned char* block, size_t size);
+
+    void account(int category, size_t bytes, bool add);
+    void addUsed(size_t bytes);
+
+    static int categoryOf(FMOD_MEMORY_TYPE type);
+
+    static void* F_CALL allocCallback(unsigned int size, FMOD_MEMORY_TYPE type, const char* sourcestr);
+    static void* F_CALL reallocCallback(void* ptr, unsigned int size, FMOD_MEMORY_TYPE type, const char* sourcestr);
+    static void F_CALL freeCallback(void* ptr, FMOD_MEMORY_TYPE type, const char* sourcestr);
+
+    // The installed allocator, FMOD's memory callbacks take no user data
+    static AudioAllocator* installed;
+
+    unsigned char* memory;
+    size_t capacity;
+
+    // Free blocks outside the size classes, in address order so neighbours can be merged
+    FreeBlock* freeList = nullptr;
+    std::mutex largeMutex;
+
+    // Free blocks of each size class, and the lock guarding each list
+    FreeBlock* classFreeLists[SIZE_CLASS_COUNT] = { };
+    std::mutex classMutexes[SIZE_CLASS_COUNT];
+
+    std::atomic<size_t> usedBytes { 0 };
+    std::atomic<size_t> peakUsedBytes { 0 };
+    std::atomic<size_t> failedAllocations { 0 };
+    std::atomic<size_t> categoryBytes[AudioMemoryStats::CATEGORY_COUNT];
+    std::atomic<size_t> categoryPeakBytes[AudioMemoryStats::CATEGORY_COUNT];
+    std::atomic<size_t> categoryAllocations[AudioMemoryStats::CATEGORY_COUNT];
+};
@@ -3,237 +3,2217 @@
 /// @author Ross Hoyt
 ///
 #include "AudioEngine.h"
-#include <FMOD/fmod_errors.h>
-#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <thread>
 
-AudioEngine::AudioEngine() : sounds(), loopsPlaying(), soundBanks(),
-eventDescriptions(), eventInstances() {}
+AudioEngine* AudioEngine::callbackEngine = nullptr;
 
-void AudioEngine::init() {
+AudioEngine::AudioEngine() : reverbZones(), occlusion(), occlusionCandidates(), sounds(), soundHandles(), soundLRU(), loadingSounds(), voices(), emitters(), emitterRegistry(), endedVoices(MAX_AUDIO_CHANNELS),
+loopsPlaying(), commands(COMMAND_QUEUE_CAPACITY),
+soundBanks(), unloadingBanks(), loadingBanks(), manifestLoads(), loadingSampleData(), events(), eventHandles(), eventInstances(), stoppedEventInstances(COMMAND_QUEUE_CAPACITY),
+pendingParameters(), parameterBatchIDs(), parameterBatchValues() {}
+
+void AudioEngine::init(const AudioEngineSettings& settings) {
+    AUDIO_TRACE_FUNCTION();
+    Logger::get().start();
+    if (settings.memoryPoolBytes > 0 && !AudioAllocator::isInstalled())
+        ERRCHECK(AudioAllocator::install(settings.memoryPoolBytes));
     ERRCHECK(FMOD::Studio::System::create(&studioSystem));
     ERRCHECK(studioSystem->getCoreSystem(&lowLevelSystem));
     ERRCHECK(lowLevelSystem->setSoftwareFormat(AUDIO_SAMPLE_RATE, FMOD_SPEAKERMODE_STEREO, 0));
+    ERRCHECK(lowLevelSystem->setSoftwareChannels(settings.maxRealVoices));
+    FMOD_ADVANCEDSETTINGS advancedSettings = { };
+    advancedSettings.cbSize = sizeof(FMOD_ADVANCEDSETTINGS);
+    ERRCHECK(lowLevelSystem->getAdvancedSettings(&advancedSettings));
+    advancedSettings.vol0virtualvol = settings.virtualVoiceVolume;
+    ERRCHECK(lowLevelSystem->setAdvancedSettings(&advancedSettings));
     ERRCHECK(lowLevelSystem->set3DSettings(1.0, DISTANCEFACTOR, 0.5f));
-    ERRCHECK(studioSystem->initialize(MAX_AUDIO_CHANNELS, FMOD_STUDIO_INIT_NORMAL, FMOD_INIT_NORMAL, 0));
+    ERRCHECK(packFileSystem.install(lowLevelSystem));
+    ERRCHECK(studioSystem->initialize(settings.maxVoices, FMOD_STUDIO_INIT_NORMAL, FMOD_INIT_VOL0_BECOMES_VIRTUAL, 0));
     ERRCHECK(lowLevelSystem->getMasterChannelGroup(&mastergroup));
-    initReverb();
+    voices.reserve(settings.maxVoices);
+    emitters.reserve(settings.maxVoices);
+    callbackEngine = this;
+    reverbZones.init(lowLevelSystem, settings.maxActiveReverbZones);
+    addDefaultReverbZone();
+    occlusionRaysPerUpdate = settings.occlusionRaysPerUpdate;
+    occlusion.start();
+    statsHistory.setCapacity(size_t(std::max(settings.statsWindowFrames, 1)));
 }
 
 void AudioEngine::deactivate() {
+    AUDIO_TRACE_FUNCTION();
+    occlusion.stop();
+    for (SoundData& soundData : sounds)
+        ERRCHECK(soundData.sound->release());
+    sounds.clear();
+    soundHandles.clear();
+    soundLRU.clear();
+    soundMemoryUsed = 0;
+    loadingSounds.clear();
+    voices.clear();
+    emitters.clear();
+    emitterRegistry.clear();
+    voiceCategories.clear();
+    loopsPlaying.clear();
+    events.clear();
+    eventHandles.clear();
+    eventInstances.clear();
+    pendingParameters.clear();
+    loadingBanks.clear();
+    manifestLoads.clear();
+    loadingSampleData.clear();
+    reverbZones.release();
+    defaultReverbZone = ReverbZoneHandle();
+    numListeners = 1;
+    listeners[0].dirty = true;
     lowLevelSystem->close();
     studioSystem->release();
+    soundBanks.clear();
+    unloadingBanks.clear(); // only once FMOD has released the banks reading from their mappings
+    packFileSystem.unmountAll();
+    EndedVoice endedVoice;
+    while (endedVoices.pop(endedVoice)) {}
+    StoppedEventInstance stoppedInstance;
+    while (stoppedEventInstances.pop(stoppedInstance)) {}
+    stoppedEventsDropped.store(false, std::memory_order_relaxed);
+    callbackEngine = nullptr;
+    statsHistory.clear();
+    lastSampleBytesRead = 0;
+    lastStreamBytesRead = 0;
+    lastOtherBytesRead = 0;
+    commandQueueHighWater = 0;
+    Logger::get().stop(); // writes anything logged during shutdown
 }
 
 void AudioEngine::update() {
-    ERRCHECK(studioSystem->update()); // also updates the low level system
-}
-
-void AudioEngine::loadSound(SoundInfo soundInfo) {
-    if (!soundInfo.isLoaded()) {
-        std::cout << "Audio Engine: Loading Sound from file " << soundInfo.getFilePath() << '\n';
-        FMOD::Sound* sound;
-        ERRCHECK(lowLevelSystem->createSound(soundInfo.getFilePath(), soundInfo.is3D() ? FMOD_3D : FMOD_2D, 0, &sound));
-        ERRCHECK(sound->setMode(soundInfo.isLoop() ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF));
-        ERRCHECK(sound->set3DMinMaxDistance(0.5f * DISTANCEFACTOR, 5000.0f * DISTANCEFACTOR));
-        sounds.insert({ soundInfo.getUniqueID(), sound });
-        unsigned int msLength = 0;
-        ERRCHECK(sounds[soundInfo.getUniqueID()]->getLength(&msLength, FMOD_TIMEUNIT_MS));
-        //soundInfo.setMSLength(msLength);
-        soundInfo.setLoaded(SOUND_LOADED);
+    AUDIO_TRACE_FUNCTION();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    float deltaSeconds = hasUpdated ? std::chrono::duration<float>(now - lastUpdateTime).count() : 0.0f;
+    lastUpdateTime = now;
+    hasUpdated = true;
+    update(deltaSeconds);
+}
+
+void AudioEngine::update(float deltaSeconds) {
+    AUDIO_TRACE_FUNCTION();
+    std::chrono::steady_clock::time_point updateStart = std::chrono::steady_clock::now();
+    processEndedVoices();
+    processStoppedEventInstances();
+    updateLoadingSounds();
+    updateLoadingBanks();
+    processCommands();
+    updateEmitters();
+    emitters.deriveVelocities(deltaSeconds);
+    flushEmitters();
+    updateListeners(deltaSeconds);
+    reverbZones.update(listenerPositions, numListeners);
+    updateOcclusion();
+    enforceSoundMemoryBudget();
+    flushEventParameters();
+    {
+        AUDIO_TRACE_SCOPE("Studio::System::update");
+        ERRCHECK(studioSystem->update()); // also updates the low level system
+    }
+    recordStats(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - updateStart).count());
+}
+
+AudioResult<SoundHandle> AudioEngine::loadSound(SoundInfo soundInfo, SoundLoadPolicy policy) {
+    AUDIO_TRACE_FUNCTION();
+    auto existing = soundHandles.find(soundInfo.getUniqueID());
+    if (existing == soundHandles.end()) {
+        AUDIO_LOG_INFO("Audio Engine: Loading Sound from file %s", soundInfo.getFilePath());
+        AudioResult<SoundHandle> created = createSound(soundInfo, false, policy);
+        if (created)
+            finishLoadingSound(*sounds.get(*created));
+        return created;
+    }
+    AUDIO_LOG_WARNING("Audio Engine: Sound File was already loaded!");
+    SoundHandle handle = existing->second;
+    if (sounds.get(handle)->loadState == SoundLoadState::LOADING) {
+        // an asynchronous load of the same sound is still opening, wait for it so the handle is ready on return
+        FMOD_RESULT result;
+        while ((result = completeSoundLoad(handle)) == FMOD_ERR_NOTREADY)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (result != FMOD_OK)
+            return result;
     }
+    retainSound(handle);
+    return handle;
+}
+
+SoundHandle AudioEngine::loadSoundAsync(SoundInfo soundInfo, SoundLoadedCallback onLoaded, SoundLoadPolicy policy) {
+    AUDIO_TRACE_FUNCTION();
+    auto existing = soundHandles.find(soundInfo.getUniqueID());
+    if (existing != soundHandles.end()) {
+        SoundData* soundData = sounds.get(existing->second);
+        soundData->refCount++;
+        if (onLoaded) {
+            if (soundData->loadState == SoundLoadState::LOADING)
+                soundData->onLoaded.push_back(onLoaded);
+            else
+                onLoaded(existing->second, true);
+        }
+        return existing->second;
+    }
+    AUDIO_LOG_INFO("Audio Engine: Loading Sound asynchronously from file %s", soundInfo.getFilePath());
+    SoundHandle handle = createSound(soundInfo, true, policy).valueOr(SoundHandle());
+    if (SoundData* soundData = sounds.get(handle)) {
+        if (onLoaded)
+            soundData->onLoaded.push_back(onLoaded);
+        loadingSounds.push_back(handle);
+    }
+    else if (onLoaded)
+        onLoaded(handle, false);
+    return handle;
+}
+
+std::vector<SoundHandle> AudioEngine::loadSounds(const std::vector<SoundInfo>& soundInfos, SoundLoadedCallback onLoaded,
+                                                 SoundLoadPolicy policy) {
+    AUDIO_TRACE_FUNCTION();
+    std::vector<SoundHandle> handles;
+    handles.reserve(soundInfos.size());
+    for (const SoundInfo& soundInfo : soundInfos)
+        handles.push_back(loadSoundAsync(soundInfo, onLoaded, policy));
+    return handles;
+}
+
+void AudioEngine::setLoadPolicyThresholds(unsigned long long compressedBytes, unsigned long long streamBytes) {
+    AUDIO_TRACE_FUNCTION();
+    compressedThresholdBytes = compressedBytes;
+    streamThresholdBytes = streamBytes;
+}
+
+SoundLoadState AudioEngine::getSoundLoadState(SoundHandle sound) {
+    AUDIO_TRACE_FUNCTION();
+    const SoundData* soundData = sounds.get(sound);
+    return soundData ? soundData->loadState : SoundLoadState::FAILED;
+}
+
+bool AudioEngine::mountPackFile(const char* filePath) {
+    AUDIO_TRACE_FUNCTION();
+    AUDIO_LOG_INFO("Audio Engine: Mounting pack file %s", filePath);
+    bool mounted = packFileSystem.mount(filePath);
+    if (!mounted)
+        AUDIO_LOG_ERROR("Audio Engine: Couldn't mount pack file %s", filePath);
+    return mounted;
+}
+
+void AudioEngine::unmountPackFile(const char* filePath) {
+    AUDIO_TRACE_FUNCTION();
+    packFileSystem.unmount(filePath);
+}
+
+void AudioEngine::unloadSound(SoundHandle sound) {
+    AUDIO_TRACE_FUNCTION();
+    SoundData* soundData = sounds.get(sound);
+    if (soundData && soundData->refCount > 0)
+        soundData->refCount--;
     else
-        std::cout << "Audio Engine: Sound File was already loaded!\n";
+        AUDIO_LOG_WARNING("Audio Engine: Can't unload a sound that isn't loaded!");
 }
 
-void AudioEngine::playSound(SoundInfo soundInfo) {
-    if (!soundInfo.isLoaded()) {
-        //std::cout << "Playing Sound\n";
-        FMOD::Channel* channel;
-        // start play in 'paused' state
-        ERRCHECK(lowLevelSystem->playSound(sounds[soundInfo.getUniqueID()], 0, true /* start paused */, &channel));
+void AudioEngine::retainSound(SoundHandle sound) {
+    AUDIO_TRACE_FUNCTION();
+    if (SoundData* soundData = sounds.get(sound))
+        soundData->refCount++;
+}
 
-        if (soundInfo.is3D())
-            set3dChannelPosition(soundInfo, channel);
+void AudioEngine::setSoundMemoryBudget(unsigned long long budgetBytes) {
+    AUDIO_TRACE_FUNCTION();
+    soundMemoryBudget = budgetBytes;
+}
 
-        //std::cout << "Playing sound at volume " << soundInfo.getVolume() << '\n';
-        channel->setVolume(soundInfo.getVolume());
+void AudioEngine::purgeUnusedSounds() {
+    AUDIO_TRACE_FUNCTION();
+    for (auto it = soundLRU.begin(); it != soundLRU.end(); ) {
+        SoundHandle sound = *it++; // advance first, eviction erases the list node
+        if (soundIsEvictable(*sounds.get(sound)))
+            evictSound(sound);
+    }
+}
 
-        if (soundInfo.isLoop()) // add to channel map of sounds currently playing, to stop later
-            loopsPlaying.insert({ soundInfo.getUniqueID(), channel });
+unsigned long long AudioEngine::getSoundMemoryUsage() {
+    AUDIO_TRACE_FUNCTION();
+    return soundMemoryUsed;
+}
 
-        ERRCHECK(channel->setReverbProperties(0, soundInfo.getReverbAmount()));
+int AudioEngine::getFMODMemoryUsage() {
+    AUDIO_TRACE_FUNCTION();
+    int currentAlloced = 0;
+    ERRCHECK(FMOD::Memory_GetStats(&currentAlloced, 0, false));
+    return currentAlloced;
+}
 
-        // start audio playback
-        ERRCHECK(channel->setPaused(false));
+AudioStats AudioEngine::getStats() {
+    AUDIO_TRACE_FUNCTION();
+    AudioStats stats;
+    statsHistory.summarize(stats);
+    stats.totalSampleBytesRead = lastSampleBytesRead;
+    stats.totalStreamBytesRead = lastStreamBytesRead;
+    stats.totalOtherBytesRead = lastOtherBytesRead;
 
+    stats.commandQueueHighWater = commandQueueHighWater;
+    stats.commandQueueCapacity = commands.capacity();
+    FMOD_STUDIO_BUFFER_USAGE bufferUsage = { };
+    if (ERRCHECK(studioSystem->getBufferUsage(&bufferUsage)) == FMOD_OK) {
+        stats.studioCommandQueuePeak = bufferUsage.studiocommandqueue.peakusage;
+        stats.studioCommandQueueCapacity = bufferUsage.studiocommandqueue.capacity;
+        stats.studioCommandQueueStalls = bufferUsage.studiocommandqueue.stallcount;
+        stats.studioHandlePeak = bufferUsage.studiohandle.peakusage;
+        stats.studioHandleCapacity = bufferUsage.studiohandle.capacity;
     }
-    else
-        std::cout << "Audio Engine: Can't play, sound was not loaded yet from " << soundInfo.getFilePath() << '\n';
 
+    ERRCHECK(FMOD::Memory_GetStats(&stats.fmodCurrentBytes, &stats.fmodPeakBytes, false));
+    FMOD_STUDIO_MEMORY_USAGE studioMemory = { };
+    if (ERRCHECK(studioSystem->getMemoryUsage(&studioMemory)) == FMOD_OK) {
+        stats.studioBytes = studioMemory.inclusive;
+        stats.studioSampleDataBytes = studioMemory.sampledata;
+    }
+    stats.soundCacheBytes = soundMemoryUsed;
+    stats.soundMemoryBudget = soundMemoryBudget;
+    for (const auto& bank : soundBanks)
+        stats.bankFileBytes += bank.second.fileBytes;
+
+    stats.sounds = sounds.size();
+    stats.voices = voices.size();
+    stats.emitters = emitterRegistry.size();
+    stats.events = events.size();
+    stats.eventInstances = eventInstances.size();
+    return stats;
 }
 
-void AudioEngine::stopSound(SoundInfo soundInfo) {
-    if (soundIsPlaying(soundInfo)) {
-        ERRCHECK(loopsPlaying[soundInfo.getUniqueID()]->stop());
-        loopsPlaying.erase(soundInfo.getUniqueID());
+AudioMemoryStats AudioEngine::getMemoryPoolStats() {
+    AUDIO_TRACE_FUNCTION();
+    return AudioAllocator::getStats();
+}
+
+void AudioEngine::resetStats() {
+    AUDIO_TRACE_FUNCTION();
+    statsHistory.clear();
+    commandQueueHighWater = 0;
+    ERRCHECK(studioSystem->resetBufferUsage());
+}
+
+void AudioEngine::recordStats(float updateMs) {
+    AudioFrameSample sample;
+    sample.engineUpdateMs = updateMs;
+    FMOD_STUDIO_CPU_USAGE cpuUsage = { };
+    if (ERRCHECK(studioSystem->getCPUUsage(&cpuUsage)) == FMOD_OK) {
+        sample.dspCPU = cpuUsage.dspusage;
+        sample.streamCPU = cpuUsage.streamusage;
+        sample.geometryCPU = cpuUsage.geometryusage;
+        sample.fmodUpdateCPU = cpuUsage.updateusage;
+        sample.studioCPU = cpuUsage.studiousage;
     }
-    else
-        std::cout << "Audio Engine: Can't stop a looping sound that's not playing!\n";
+    int channelsPlaying = 0, realChannels = 0;
+    if (ERRCHECK(lowLevelSystem->getChannelsPlaying(&channelsPlaying, &realChannels)) == FMOD_OK) {
+        sample.realVoices = float(realChannels);
+        sample.virtualVoices = float(channelsPlaying - realChannels);
+    }
+    long long sampleBytes = 0, streamBytes = 0, otherBytes = 0;
+    if (ERRCHECK(lowLevelSystem->getFileUsage(&sampleBytes, &streamBytes, &otherBytes)) == FMOD_OK) {
+        sample.sampleBytesRead = float(sampleBytes - lastSampleBytesRead);
+        sample.streamBytesRead = float(streamBytes - lastStreamBytesRead);
+        sample.otherBytesRead = float(otherBytes - lastOtherBytesRead);
+        lastSampleBytesRead = sampleBytes;
+        lastStreamBytesRead = streamBytes;
+        lastOtherBytesRead = otherBytes;
+    }
+    statsHistory.add(sample);
 }
 
-void AudioEngine::updateSoundLoopVolume(SoundInfo& soundInfo, float newVolume, unsigned int fadeSampleLength) {
-    if (soundIsPlaying(soundInfo)) {
-        FMOD::Channel* channel = loopsPlaying[soundInfo.getUniqueID()];
-        if (fadeSampleLength <= 64) // 64 samples is default volume fade out
-            ERRCHECK(channel->setVolume(newVolume));
-        else {
-            bool fadeUp = newVolume > soundInfo.getVolume();
-            // get current audio clock time
-            unsigned long long parentclock = 0;
-            ERRCHECK(channel->getDSPClock(NULL, &parentclock));
+void AudioEngine::setSound3DMinMaxDistance(SoundHandle sound, float minDistance, float maxDistance) {
+    AUDIO_TRACE_FUNCTION();
+    SoundData* soundData = sounds.get(sound);
+    if (!soundData)
+        return;
+    soundData->minDistance = minDistance;
+    soundData->maxDistance = maxDistance;
+    if (soundData->loadState == SoundLoadState::READY)
+        ERRCHECK(soundData->sound->set3DMinMaxDistance(minDistance * DISTANCEFACTOR, maxDistance * DISTANCEFACTOR));
+    for (size_t i = 0; i < emitterRegistry.size(); i++)
+        if (emitterRegistry[i].sound == sound)
+            emitterRegistry.setMaxDistance(emitterRegistry.handleAt(i), maxDistance);
+}
 
-            float targetFadeVol = fadeUp ? 1.0f : newVolume;
+EmitterHandle AudioEngine::addEmitter(SoundHandle sound, Vec3 position, float volume, float reverbAmount) {
+    AUDIO_TRACE_FUNCTION();
+    SoundData* soundData = sounds.get(sound);
+    if (!soundData || !soundData->is3D) {
+        AUDIO_LOG_WARNING("Audio Engine: Can't add an emitter for a sound that isn't a loaded 3D sound!");
+        return EmitterHandle();
+    }
+    soundData->refCount++;
+    EmitterRegistry::Emitter emitter;
+    emitter.sound = sound;
+    emitter.volume = volume;
+    emitter.reverbAmount = reverbAmount;
+    return emitterRegistry.add(emitter, position, soundData->maxDistance);
+}
+
+void AudioEngine::removeEmitter(EmitterHandle emitter) {
+    AUDIO_TRACE_FUNCTION();
+    EmitterRegistry::Emitter* emitterData = emitterRegistry.get(emitter);
+    if (!emitterData)
+        return;
+    if (voices.contains(emitterData->voice))
+        stopSound(emitterData->voice);
+    unloadSound(emitterData->sound);
+    emitterRegistry.remove(emitter);
+}
 
-            if (fadeUp) ERRCHECK(channel->setVolume(newVolume));
+void AudioEngine::setEmitterPosition(EmitterHandle emitter, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    EmitterRegistry::Emitter* emitterData = emitterRegistry.get(emitter);
+    if (!emitterData)
+        return;
+    emitterRegistry.setPosition(emitter, position);
+    if (voices.contains(emitterData->voice))
+        update3DSoundPosition(emitterData->voice, position);
+}
+
+bool AudioEngine::emitterIsActive(EmitterHandle emitter) {
+    AUDIO_TRACE_FUNCTION();
+    EmitterRegistry::Emitter* emitterData = emitterRegistry.get(emitter);
+    return emitterData && voices.contains(emitterData->voice);
+}
 
-            ERRCHECK(channel->addFadePoint(parentclock, soundInfo.getVolume()));
-            ERRCHECK(channel->addFadePoint(parentclock + fadeSampleLength, targetFadeVol));
-            //std::cout << "Current DSP Clock: " << parentclock << ", fade length in samples  = " << fadeSampleLength << "\n";
+void AudioEngine::getEmittersInRadius(Vec3 center, float radius, std::vector<EmitterHandle>& results) {
+    AUDIO_TRACE_FUNCTION();
+    emitterRegistry.queryRadius(center, radius, results);
+}
+
+ReverbZoneHandle AudioEngine::addReverbZone(const FMOD_REVERB_PROPERTIES& properties, Vec3 position, float minDistance, float maxDistance) {
+    AUDIO_TRACE_FUNCTION();
+    if (defaultReverbZone.isValid()) {
+        reverbZones.remove(defaultReverbZone);
+        defaultReverbZone = ReverbZoneHandle();
+    }
+    return reverbZones.add(properties, position, minDistance, maxDistance);
+}
+
+void AudioEngine::removeReverbZone(ReverbZoneHandle zone) {
+    AUDIO_TRACE_FUNCTION();
+    reverbZones.remove(zone);
+    if (reverbZones.empty())
+        addDefaultReverbZone();
+}
+
+void AudioEngine::setReverbZonePosition(ReverbZoneHandle zone, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    reverbZones.setPosition(zone, position);
+}
+
+void AudioEngine::setReverbZoneProperties(ReverbZoneHandle zone, const FMOD_REVERB_PROPERTIES& properties) {
+    AUDIO_TRACE_FUNCTION();
+    reverbZones.setProperties(zone, properties);
+}
+
+void AudioEngine::setReverbZoneDistances(ReverbZoneHandle zone, float minDistance, float maxDistance) {
+    AUDIO_TRACE_FUNCTION();
+    reverbZones.setDistances(zone, minDistance, maxDistance);
+}
+
+void AudioEngine::setMaxActiveReverbZones(int maxActive) {
+    AUDIO_TRACE_FUNCTION();
+    reverbZones.setMaxActive(maxActive);
+}
+
+bool AudioEngine::reverbZoneIsActive(ReverbZoneHandle zone) {
+    AUDIO_TRACE_FUNCTION();
+    return reverbZones.isActive(zone);
+}
+
+OcclusionMeshHandle AudioEngine::addOcclusionMesh(const Vec3* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                                                  float directOcclusion, float reverbOcclusion) {
+    AUDIO_TRACE_FUNCTION();
+    OcclusionMesh mesh;
+    mesh.vertices.assign(vertices, vertices + vertexCount);
+    mesh.indices.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) {
+            AUDIO_LOG_WARNING("Audio Engine: Occlusion mesh index out of range, skipping triangle %zu", size_t(i / 3));
+            continue;
         }
-        //std::cout << "Updating with new soundinfo vol \n";
+        mesh.indices.insert(mesh.indices.end(), indices + i, indices + i + 3);
+    }
+    mesh.directOcclusion = directOcclusion;
+    mesh.reverbOcclusion = reverbOcclusion;
+    return occlusion.addMesh(mesh);
+}
+
+void AudioEngine::removeOcclusionMesh(OcclusionMeshHandle mesh) {
+    AUDIO_TRACE_FUNCTION();
+    occlusion.removeMesh(mesh);
+    if (occlusion.hasMeshes())
+        return;
+    // nothing left to occlude, results still in flight are discarded by updateOcclusion()
+    for (VoiceData& voiceData : voices)
+        if (voiceData.channel && voiceData.emitter != EmitterStore::NO_EMITTER)
+            ERRCHECK(voiceData.channel->set3DOcclusion(0.0f, 0.0f));
+}
+
+void AudioEngine::setOcclusionRaysPerUpdate(int rays) {
+    AUDIO_TRACE_FUNCTION();
+    occlusionRaysPerUpdate = rays;
+}
+
+SoundHandle AudioEngine::getSoundHandle(SoundInfo soundInfo) {
+    AUDIO_TRACE_FUNCTION();
+    auto it = soundHandles.find(soundInfo.getUniqueID());
+    return it != soundHandles.end() ? it->second : SoundHandle();
+}
+
+void AudioEngine::playSound(SoundInfo soundInfo) {
+    AUDIO_TRACE_FUNCTION();
+    SoundHandle sound = getSoundHandle(soundInfo);
+    if (sounds.contains(sound)) {
+        Vec3 position = { soundInfo.getX(), soundInfo.getY(), soundInfo.getZ() };
+        VoiceHandle voice = playSound(sound, soundInfo.getVolume(), soundInfo.getReverbAmount(), position).valueOr(VoiceHandle());
+        if (voice.isValid() && soundInfo.isLoop()) { // add to map of loops currently playing, to stop later
+            auto it = loopsPlaying.find(soundInfo.getUniqueID());
+            if (it == loopsPlaying.end())
+                loopsPlaying.insert({ soundInfo.getUniqueID(), voice });
+            else if (!voices.contains(it->second)) // the previous loop's channel ended
+                it->second = voice;
+        }
+    }
+    else
+        AUDIO_LOG_WARNING("Audio Engine: Can't play, sound was not loaded yet from %s", soundInfo.getFilePath());
+
+}
+
+AudioResult<VoiceHandle> AudioEngine::playSound(SoundHandle sound, float volume, float reverbAmount, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    SoundData* soundData = sounds.get(sound);
+    if (!soundData) {
+        AUDIO_LOG_WARNING("Audio Engine: Can't play, sound handle is stale");
+        return FMOD_ERR_INVALID_HANDLE;
+    }
+
+    if (!enforceVoiceLimits(sound, *soundData))
+        return FMOD_ERR_CHANNEL_ALLOC;
+    soundData = sounds.get(sound);
+
+    VoiceData voiceData;
+    voiceData.sound = sound;
+    voiceData.volume = volume;
+    voiceData.reverbAmount = reverbAmount;
+    voiceData.priority = soundData->priority;
+    voiceData.category = soundData->category;
+    voiceData.startOrder = voiceStartCounter++;
+    VoiceHandle voice = addVoice(voiceData, soundData->is3D, position);
+
+    if (soundData->loadState == SoundLoadState::LOADING) { // start the voice once the sound has loaded
+        soundData->pendingVoices.push_back(voice);
+        return voice;
+    }
+
+    touchSound(*soundData);
+    FMOD_RESULT result = startVoice(voice);
+    if (result != FMOD_OK) {
+        removeVoice(voice);
+        return result;
+    }
+    return voice;
+}
+
+void AudioEngine::stopSound(SoundInfo soundInfo) {
+    AUDIO_TRACE_FUNCTION();
+    auto it = loopsPlaying.find(soundInfo.getUniqueID());
+    if (soundInfo.isLoop() && it != loopsPlaying.end() && voices.contains(it->second)) {
+        stopSound(it->second);
+        loopsPlaying.erase(it);
+    }
+    else
+        AUDIO_LOG_WARNING("Audio Engine: Can't stop a looping sound that's not playing!");
+}
+
+FMOD_RESULT AudioEngine::stopSound(VoiceHandle voice) {
+    AUDIO_TRACE_FUNCTION();
+    VoiceData* voiceData = voices.get(voice);
+    if (!voiceData) {
+        AUDIO_LOG_WARNING("Audio Engine: Can't stop a sound that's not playing!");
+        return FMOD_ERR_INVALID_HANDLE;
+    }
+    FMOD_RESULT result = FMOD_OK;
+    if (voiceData->channel) // voices still waiting on their sound to load have no channel yet
+        result = ERRCHECK(voiceData->channel->stop());
+    removeVoice(voice);
+    return result;
+}
+
+void AudioEngine::updateSoundLoopVolume(SoundInfo& soundInfo, float newVolume, unsigned int fadeSampleLength) {
+    AUDIO_TRACE_FUNCTION();
+    auto it = loopsPlaying.find(soundInfo.getUniqueID());
+    if (soundInfo.isLoop() && it != loopsPlaying.end() && voices.contains(it->second)) {
+        updateSoundLoopVolume(it->second, newVolume, fadeSampleLength);
+        //AUDIO_LOG_DEBUG("Updating with new soundinfo vol");
         soundInfo.setVolume(newVolume); // update the SoundInfo's volume
     }
     else
-        std::cout << "AudioEngine: Can't update sound loop volume! (It isn't playing or might not be loaded)\n";
+        AUDIO_LOG_WARNING("AudioEngine: Can't update sound loop volume! (It isn't playing or might not be loaded)");
 }
 
+FMOD_RESULT AudioEngine::updateSoundLoopVolume(VoiceHandle voice, float newVolume, unsigned int fadeSampleLength) {
+    AUDIO_TRACE_FUNCTION();
+    VoiceData* voiceData = voices.get(voice);
+    if (!voiceData) {
+        AUDIO_LOG_WARNING("AudioEngine: Can't update sound loop volume! (It isn't playing or might not be loaded)");
+        return FMOD_ERR_INVALID_HANDLE;
+    }
+    voiceData->volume = newVolume;
+    FMOD::Channel* channel = voiceData->channel;
+    if (!channel) // still loading, the voice will start at the new volume
+        return FMOD_OK;
+    if (fadeSampleLength <= 64) // 64 samples is default volume fade out
+        return ERRCHECK(channel->setVolume(newVolume));
+
+    float currentVolume = 0.0f;
+    FMOD_RESULT result = ERRCHECK(channel->getVolume(&currentVolume));
+    if (result != FMOD_OK)
+        return result;
+    bool fadeUp = newVolume > currentVolume;
+    // get current audio clock time
+    unsigned long long parentclock = 0;
+    result = ERRCHECK(channel->getDSPClock(NULL, &parentclock));
+    if (result != FMOD_OK)
+        return result;
 
+    float targetFadeVol = fadeUp ? 1.0f : newVolume;
+
+    if (fadeUp) {
+        result = ERRCHECK(channel->setVolume(newVolume));
+        if (result != FMOD_OK)
+            return result;
+    }
+
+    result = ERRCHECK(channel->addFadePoint(parentclock, currentVolume));
+    if (result != FMOD_OK)
+        return result;
+    //AUDIO_LOG_DEBUG("Current DSP Clock: %llu, fade length in samples  = %u", parentclock, fadeSampleLength);
+    return ERRCHECK(channel->addFadePoint(parentclock + fadeSampleLength, targetFadeVol));
+}
 
 void AudioEngine::update3DSoundPosition(SoundInfo soundInfo) {
-    if (soundIsPlaying(soundInfo))
-        set3dChannelPosition(soundInfo, loopsPlaying[soundInfo.getUniqueID()]);
+    AUDIO_TRACE_FUNCTION();
+    auto it = loopsPlaying.find(soundInfo.getUniqueID());
+    if (soundInfo.isLoop() && it != loopsPlaying.end() && voices.contains(it->second))
+        update3DSoundPosition(it->second, { soundInfo.getX(), soundInfo.getY(), soundInfo.getZ() });
     else
-        std::cout << "Audio Engine: Can't update sound position!\n";
+        AUDIO_LOG_WARNING("Audio Engine: Can't update sound position!");
+
+}
+
+FMOD_RESULT AudioEngine::update3DSoundPosition(VoiceHandle voice, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    VoiceData* voiceData = voices.get(voice);
+    if (!voiceData || voiceData->emitter == EmitterStore::NO_EMITTER) {
+        AUDIO_LOG_WARNING("Audio Engine: Can't update sound position!");
+        return FMOD_ERR_INVALID_HANDLE;
+    }
+    emitters.setPosition(voiceData->emitter, position);
+    return FMOD_OK;
+}
+
+void AudioEngine::set3DPositions(const VoiceHandle* voiceHandles, const Vec3* positions, size_t count) {
+    AUDIO_TRACE_FUNCTION();
+    for (size_t i = 0; i < count; i++) {
+        const VoiceData* voiceData = voices.get(voiceHandles[i]);
+        // voices which ended since the caller last checked are skipped silently
+        if (voiceData && voiceData->emitter != EmitterStore::NO_EMITTER)
+            emitters.setPosition(voiceData->emitter, positions[i]);
+    }
+}
 
+void AudioEngine::set3DPositions(const std::vector<VoiceHandle>& voiceHandles, const std::vector<Vec3>& positions) {
+    AUDIO_TRACE_FUNCTION();
+    set3DPositions(voiceHandles.data(), positions.data(), voiceHandles.size() < positions.size() ? voiceHandles.size() : positions.size());
 }
 
 bool AudioEngine::soundIsPlaying(SoundInfo soundInfo) {
-    return soundInfo.isLoop() && loopsPlaying.count(soundInfo.getUniqueID());
+    AUDIO_TRACE_FUNCTION();
+    auto it = loopsPlaying.find(soundInfo.getUniqueID());
+    return soundInfo.isLoop() && it != loopsPlaying.end() && voices.contains(it->second);
+}
+
+bool AudioEngine::soundIsPlaying(VoiceHandle voice) {
+    AUDIO_TRACE_FUNCTION();
+    return voices.contains(voice);
+}
+
+bool AudioEngine::soundIsVirtual(VoiceHandle voice) {
+    AUDIO_TRACE_FUNCTION();
+    VoiceData* voiceData = voices.get(voice);
+    bool isVirtual = false;
+    if (voiceData && voiceData->channel)
+        ERRCHECK(voiceData->channel->isVirtual(&isVirtual));
+    return isVirtual;
+}
+
+void AudioEngine::setSoundVoiceLimit(SoundHandle sound, int maxInstances, VoiceStealPolicy policy) {
+    AUDIO_TRACE_FUNCTION();
+    if (SoundData* soundData = sounds.get(sound)) {
+        if (soundData->policy == SoundLoadPolicy::STREAM && (maxInstances <= 0 || maxInstances > 1)) {
+            AUDIO_LOG_WARNING("Audio Engine: A streamed sound can only play on one voice, limiting it to 1 instead of %d", maxInstances);
+            maxInstances = 1;
+        }
+        soundData->maxInstances = maxInstances;
+        soundData->stealPolicy = policy;
+    }
+}
+
+void AudioEngine::setSoundPriority(SoundHandle sound, int priority) {
+    AUDIO_TRACE_FUNCTION();
+    if (SoundData* soundData = sounds.get(sound))
+        soundData->priority = priority;
+}
+
+void AudioEngine::setSoundCategory(SoundHandle sound, int category) {
+    AUDIO_TRACE_FUNCTION();
+    if (category < 0) {
+        AUDIO_LOG_WARNING("Audio Engine: Voice categories can't be negative!");
+        return;
+    }
+    if (SoundData* soundData = sounds.get(sound)) {
+        getVoiceCategory(category);
+        soundData->category = category;
+    }
+}
+
+void AudioEngine::setCategoryVoiceLimit(int category, int maxInstances, VoiceStealPolicy policy) {
+    AUDIO_TRACE_FUNCTION();
+    if (category < 0) {
+        AUDIO_LOG_WARNING("Audio Engine: Voice categories can't be negative!");
+        return;
+    }
+    VoiceCategory& voiceCategory = getVoiceCategory(category);
+    voiceCategory.maxInstances = maxInstances;
+    voiceCategory.stealPolicy = policy;
 }
 
 void AudioEngine::set3DListenerPosition(float posX, float posY, float posZ, float forwardX, float forwardY, float forwardZ, float upX, float upY, float upZ) {
-    listenerpos = { posX,     posY,     posZ };
-    forward       { forwardX, forwardY, forwardZ };
-    up =          { upX,      upY,      upZ };
-    ERRCHECK(lowLevelSystem->set3DListenerAttributes(0, &listenerpos, 0, &forward, &up));
+    AUDIO_TRACE_FUNCTION();
+    set3DListenerPosition(0, posX, posY, posZ, forwardX, forwardY, forwardZ, upX, upY, upZ);
+}
+
+void AudioEngine::set3DListenerPosition(int listener, float posX, float posY, float posZ, float forwardX, float forwardY, float forwardZ,
+                                        float upX, float upY, float upZ) {
+    AUDIO_TRACE_FUNCTION();
+    if (listener < 0 || listener >= numListeners) {
+        AUDIO_LOG_WARNING("Audio Engine: Listener %d doesn't exist, there are %d listeners", listener, numListeners);
+        return;
+    }
+    listeners[listener].position = { posX,     posY,     posZ };
+    listeners[listener].forward =  { forwardX, forwardY, forwardZ };
+    listeners[listener].up =       { upX,      upY,      upZ };
+    listeners[listener].dirty = true;
+    listenerPositions[listener] = { posX, posY, posZ };
+}
+
+void AudioEngine::set3DNumListeners(int count) {
+    AUDIO_TRACE_FUNCTION();
+    if (count < 1 || count > FMOD_MAX_LISTENERS) {
+        AUDIO_LOG_WARNING("Audio Engine: Number of listeners must be from 1 to %d", FMOD_MAX_LISTENERS);
+        return;
+    }
+    for (int i = numListeners; i < count; i++) {
+        // new listeners start where the first one is, rather than at an arbitrary default
+        listeners[i] = listeners[0];
+        listeners[i].previousPosition = listeners[i].position;
+        listeners[i].velocity = { 0.0f, 0.0f, 0.0f };
+        listeners[i].dirty = true;
+        listenerPositions[i] = listenerPositions[0];
+    }
+    numListeners = count;
+    ERRCHECK(studioSystem->setNumListeners(count));
+}
+
+void AudioEngine::set3DListenerWeight(int listener, float weight) {
+    AUDIO_TRACE_FUNCTION();
+    if (listener < 0 || listener >= numListeners)
+        return;
+    ERRCHECK(studioSystem->setListenerWeight(listener, weight));
 }
 
 unsigned int AudioEngine::getSoundLengthInMS(SoundInfo soundInfo) {
+    AUDIO_TRACE_FUNCTION();
+    return getSoundLengthInMS(getSoundHandle(soundInfo));
+}
+
+unsigned int AudioEngine::getSoundLengthInMS(SoundHandle sound) {
+    AUDIO_TRACE_FUNCTION();
     unsigned int length = 0;
-    if (sounds.count(soundInfo.getUniqueID()))
-        ERRCHECK(sounds[soundInfo.getUniqueID()]->getLength(&length, FMOD_TIMEUNIT_MS));
+    const SoundData* soundData = sounds.get(sound);
+    if (soundData && soundData->loadState == SoundLoadState::READY)
+        ERRCHECK(soundData->sound->getLength(&length, FMOD_TIMEUNIT_MS));
     return length;
 }
 
-void AudioEngine::loadFMODStudioBank(const char* filepath) {
-    std::cout << "Audio Engine: Loading FMOD Studio Sound Bank " << filepath << '\n';
+FMOD_RESULT AudioEngine::loadFMODStudioBank(const char* filepath) {
+    AUDIO_TRACE_FUNCTION();
+    auto loaded = soundBanks.find(filepath);
+    if (loaded != soundBanks.end()) {
+        loaded->second.refCount++;
+        return FMOD_OK;
+    }
+    AUDIO_LOG_INFO("Audio Engine: Loading FMOD Studio Sound Bank %s", filepath);
+    FMOD::Studio::Bank* bank = NULL;
+    FMOD_RESULT result = ERRCHECK(studioSystem->loadBankFile(filepath, FMOD_STUDIO_LOAD_BANK_NORMAL, &bank));
+    if (result != FMOD_OK)
+        return result;
+    BankData bankData;
+    bankData.bank = bank;
+    packFileSystem.getFileSize(filepath, &bankData.fileBytes);
+    soundBanks.insert({ filepath, std::move(bankData) });
+    return FMOD_OK;
+}
+
+void AudioEngine::loadFMODStudioBankAsync(const char* filePath, BankLoadedCallback onLoaded, bool preloadSampleData) {
+    AUDIO_TRACE_FUNCTION();
+    auto loaded = soundBanks.find(filePath);
+    if (loaded != soundBanks.end()) {
+        loaded->second.refCount++;
+        for (LoadingBank& loadingBank : loadingBanks) {
+            if (loadingBank.filePath == filePath) {
+                loadingBank.preloadSampleData |= preloadSampleData;
+                if (onLoaded)
+                    loadingBank.onLoaded.push_back(onLoaded);
+                return;
+            }
+        }
+        if (preloadSampleData)
+            ERRCHECK(loaded->second.bank->loadSampleData());
+        if (onLoaded)
+            onLoaded(filePath, true);
+        return;
+    }
+    AUDIO_LOG_INFO("Audio Engine: Loading FMOD Studio Sound Bank asynchronously %s", filePath);
+    FMOD::Studio::Bank* bank = NULL;
+    FMOD_RESULT result = ERRCHECK(studioSystem->loadBankFile(filePath, FMOD_STUDIO_LOAD_BANK_NONBLOCKING, &bank));
+    if (result != FMOD_OK) {
+        if (onLoaded)
+            onLoaded(filePath, false);
+        return;
+    }
+    BankData bankData;
+    bankData.bank = bank;
+    packFileSystem.getFileSize(filePath, &bankData.fileBytes);
+    trackLoadingBank(filePath, std::move(bankData), onLoaded, preloadSampleData);
+}
+
+void AudioEngine::loadFMODStudioBankMapped(const char* filePath, BankLoadedCallback onLoaded, bool preloadSampleData) {
+    AUDIO_TRACE_FUNCTION();
+    if (soundBanks.find(filePath) != soundBanks.end()) { // already loaded or loading
+        loadFMODStudioBankAsync(filePath, onLoaded, preloadSampleData);
+        return;
+    }
+    AUDIO_LOG_INFO("Audio Engine: Loading FMOD Studio Sound Bank from mapped file %s", filePath);
+    unsigned int packedSize = 0;
+    const unsigned char* data = packFileSystem.find(filePath, &packedSize);
+    unsigned long long size = packedSize;
+    FMOD_STUDIO_LOAD_MEMORY_MODE mode = FMOD_STUDIO_LOAD_MEMORY_POINT;
+    std::unique_ptr<MappedFile> mapping;
+    if (data && reinterpret_cast<uintptr_t>(data) % FMOD_STUDIO_LOAD_MEMORY_ALIGNMENT != 0) {
+        // FMOD can only read banks in place at an aligned address, let it copy this one out of the pack
+        AUDIO_LOG_WARNING("Audio Engine: Bank isn't aligned to %d bytes in its pack, copying it", FMOD_STUDIO_LOAD_MEMORY_ALIGNMENT);
+        mode = FMOD_STUDIO_LOAD_MEMORY;
+    }
+    else if (!data) {
+        mapping.reset(new MappedFile());
+        if (!mapping->open(filePath)) {
+            AUDIO_LOG_ERROR("Audio Engine: Couldn't map bank %s", filePath);
+            if (onLoaded)
+                onLoaded(filePath, false);
+            return;
+        }
+        data = mapping->data();
+        size = mapping->size();
+    }
+    if (size > 0x7FFFFFFFull) { // loadBankMemory takes an int length
+        AUDIO_LOG_ERROR("Audio Engine: Bank %s is too large to load from memory", filePath);
+        if (onLoaded)
+            onLoaded(filePath, false);
+        return;
+    }
     FMOD::Studio::Bank* bank = NULL;
-    ERRCHECK(studioSystem->loadBankFile(filepath, FMOD_STUDIO_LOAD_BANK_NORMAL, &bank));
-    soundBanks.insert({ filepath, bank });
+    FMOD_RESULT result = ERRCHECK(studioSystem->loadBankMemory(reinterpret_cast<const char*>(data), int(size), mode,
+                                                               FMOD_STUDIO_LOAD_BANK_NONBLOCKING, &bank));
+    if (result != FMOD_OK) {
+        if (onLoaded)
+            onLoaded(filePath, false);
+        return;
+    }
+    BankData bankData;
+    bankData.bank = bank;
+    bankData.fileBytes = size;
+    if (mode == FMOD_STUDIO_LOAD_MEMORY_POINT)
+        bankData.source = mapping ? BankMemorySource::OWN_MAPPING : BankMemorySource::PACK_MAPPING;
+    bankData.mapping = std::move(mapping);
+    trackLoadingBank(filePath, std::move(bankData), onLoaded, preloadSampleData);
+}
+
+void AudioEngine::trackLoadingBank(const char* filePath, BankData bankData, BankLoadedCallback onLoaded, bool preloadSampleData) {
+    LoadingBank loadingBank;
+    loadingBank.filePath = filePath;
+    loadingBank.bank = bankData.bank;
+    soundBanks.insert({ filePath, std::move(bankData) });
+    loadingBank.preloadSampleData = preloadSampleData;
+    if (onLoaded)
+        loadingBank.onLoaded.push_back(onLoaded);
+    loadingBanks.push_back(loadingBank);
+}
+
+FMOD_RESULT AudioEngine::unloadFMODStudioBank(const char* filePath) {
+    AUDIO_TRACE_FUNCTION();
+    auto loaded = soundBanks.find(filePath);
+    if (loaded == soundBanks.end())
+        return FMOD_ERR_INVALID_PARAM;
+    if (--loaded->second.refCount > 0)
+        return FMOD_OK;
+    AUDIO_LOG_INFO("Audio Engine: Unloading FMOD Studio Sound Bank %s", filePath);
+    // callbacks of a load still in progress are told it failed, once the bank is gone
+    LoadingBank cancelled;
+    for (size_t i = 0; i < loadingBanks.size(); i++) {
+        if (loadingBanks[i].filePath == filePath) {
+            cancelled = std::move(loadingBanks[i]);
+            loadingBanks[i] = std::move(loadingBanks.back());
+            loadingBanks.pop_back();
+            break;
+        }
+    }
+    // release the engine's events which only this bank provides, so none of the instances the engine created
+    // outlive it. Instances created outside the engine are left to FMOD, which stops them as the bank unloads
+    std::vector<FMOD::Studio::EventDescription*> descriptions;
+    getBankEvents(loaded->second.bank, descriptions);
+    std::vector<FMOD::Studio::EventDescription*> shared;
+    for (auto& other : soundBanks)
+        if (other.second.bank != loaded->second.bank)
+            getBankEvents(other.second.bank, shared);
+    std::vector<EventHandle> dependents;
+    for (size_t i = 0; i < events.size(); i++) {
+        FMOD::Studio::EventDescription* description = events[i].description;
+        if (std::find(descriptions.begin(), descriptions.end(), description) != descriptions.end()
+                && std::find(shared.begin(), shared.end(), description) == shared.end())
+            dependents.push_back(events.handleAt(i));
+    }
+    if (!dependents.empty())
+        AUDIO_LOG_WARNING("Audio Engine: Bank %s unloaded while %zu of its events are loaded, releasing them", filePath, dependents.size());
+    for (EventHandle event : dependents)
+        releaseEvent(event);
+    FMOD_RESULT result = beginUnloadingBank(loaded->second);
+    soundBanks.erase(loaded);
+    // called last, a callback may load the bank again
+    for (const BankLoadedCallback& callback : cancelled.onLoaded)
+        callback(cancelled.filePath, false);
+    return result;
+}
+
+void AudioEngine::getBankEvents(FMOD::Studio::Bank* bank, std::vector<FMOD::Studio::EventDescription*>& descriptions) {
+    int eventCount = 0;
+    if (bank->getEventCount(&eventCount) != FMOD_OK || eventCount <= 0)
+        return;
+    size_t first = descriptions.size();
+    descriptions.resize(first + size_t(eventCount));
+    ERRCHECK(bank->getEventList(descriptions.data() + first, eventCount, &eventCount));
+    descriptions.resize(first + size_t(eventCount));
+}
+
+FMOD_RESULT AudioEngine::beginUnloadingBank(BankData& bankData) {
+    FMOD_RESULT result = ERRCHECK(bankData.bank->unload());
+    // FMOD finishes unloading asynchronously and may read a mapped bank until it has
+    UnloadingBank unloading;
+    unloading.bank = bankData.bank;
+    unloading.mapping = std::move(bankData.mapping);
+    if (unloading.mapping)
+        unloadingBanks.push_back(std::move(unloading));
+    return result;
+}
+
+BankMemoryUsage AudioEngine::getBankMemoryUsage(const char* filePath) {
+    AUDIO_TRACE_FUNCTION();
+    BankMemoryUsage usage;
+    auto loaded = soundBanks.find(filePath);
+    if (loaded == soundBanks.end())
+        return usage;
+    usage.fileBytes = loaded->second.fileBytes;
+    usage.source = loaded->second.source;
+    usage.mapped = usage.source != BankMemorySource::HEAP;
+    int eventCount = 0;
+    if (loaded->second.bank->getEventCount(&eventCount) != FMOD_OK || eventCount == 0)
+        return usage;
+    std::vector<FMOD::Studio::EventDescription*> descriptions(eventCount);
+    ERRCHECK(loaded->second.bank->getEventList(descriptions.data(), eventCount, &eventCount));
+    descriptions.resize(size_t(eventCount));
+    auto addInstance = [&usage](FMOD::Studio::EventInstance* instance) {
+        FMOD_STUDIO_MEMORY_USAGE memory = { };
+        if (instance->getMemoryUsage(&memory) == FMOD_OK) {
+            usage.instanceBytes += (unsigned long long)memory.inclusive;
+            usage.sampleDataBytes += (unsigned long long)memory.sampledata;
+        }
+        usage.instanceCount++;
+    };
+    for (size_t i = 0; i < events.size(); i++) {
+        if (std::find(descriptions.begin(), descriptions.end(), events[i].description) == descriptions.end())
+            continue;
+        usage.eventCount++;
+        addInstance(events[i].instance);
+        for (FMOD::Studio::EventInstance* instance : events[i].pool)
+            addInstance(instance);
+        for (const EventInstanceData& instanceData : eventInstances)
+            if (instanceData.event == events.handleAt(i))
+                addInstance(instanceData.instance);
+    }
+    return usage;
 }
 
-void AudioEngine::loadFMODStudioEvent(const char* eventName, std::vector<std::pair<const char*, float>> paramsValues) { // std::vector<std::map<const char*, float>> perInstanceParameterValues) {
-    std::cout << "AudioEngine: Loading FMOD Studio Event " << eventName << '\n';
+SoundLoadState AudioEngine::getBankLoadState(const char* filePath) {
+    AUDIO_TRACE_FUNCTION();
+    if (soundBanks.find(filePath) == soundBanks.end())
+        return SoundLoadState::FAILED;
+    for (const LoadingBank& loadingBank : loadingBanks)
+        if (loadingBank.filePath == filePath)
+            return SoundLoadState::LOADING;
+    return SoundLoadState::READY;
+}
+
+void AudioEngine::preloadEventSampleData(EventHandle event, EventLoadedCallback onLoaded) {
+    AUDIO_TRACE_FUNCTION();
+    EventData* eventData = events.get(event);
+    if (!eventData) {
+        if (onLoaded)
+            onLoaded(event, false);
+        return;
+    }
+    FMOD_STUDIO_LOADING_STATE state;
+    ERRCHECK(eventData->description->getSampleLoadingState(&state));
+    if (state == FMOD_STUDIO_LOADING_STATE_LOADED) {
+        if (onLoaded)
+            onLoaded(event, true);
+        return;
+    }
+    if (onLoaded)
+        eventData->onSampleDataLoaded.push_back(onLoaded);
+    if (!eventData->sampleDataRequested) {
+        ERRCHECK(eventData->description->loadSampleData());
+        eventData->sampleDataRequested = true;
+    }
+    if (std::find(loadingSampleData.begin(), loadingSampleData.end(), event) == loadingSampleData.end())
+        loadingSampleData.push_back(event);
+}
+
+void AudioEngine::loadManifest(const AudioManifest& manifest, ManifestLoadedCallback onLoaded) {
+    AUDIO_TRACE_FUNCTION();
+    std::shared_ptr<ManifestLoad> load = std::make_shared<ManifestLoad>();
+    load->manifest = manifest;
+    load->pendingBanks = manifest.banks.size();
+    load->onLoaded = onLoaded;
+    manifestLoads.push_back(load);
+    if (manifest.banks.empty()) {
+        preloadManifestEvents(load);
+        return;
+    }
+    load->heldBanks = manifest.banks;
+    for (const std::string& bank : manifest.banks) {
+        loadFMODStudioBankAsync(bank.c_str(), [this, load](const std::string& filePath, bool success) {
+            if (load->unloaded)
+                return;
+            load->failed |= !success;
+            if (!success) { // a failed load holds no reference to release
+                auto held = std::find(load->heldBanks.begin(), load->heldBanks.end(), filePath);
+                if (held != load->heldBanks.end())
+                    load->heldBanks.erase(held);
+            }
+            if (--load->pendingBanks == 0)
+                preloadManifestEvents(load);
+        });
+    }
+}
+
+bool AudioEngine::loadManifest(const char* filePath, ManifestLoadedCallback onLoaded) {
+    AUDIO_TRACE_FUNCTION();
+    AudioManifest manifest;
+    if (!manifest.read(filePath)) {
+        AUDIO_LOG_ERROR("Audio Engine: Couldn't read manifest %s", filePath);
+        return false;
+    }
+    loadManifest(manifest, onLoaded);
+    return true;
+}
+
+void AudioEngine::preloadManifestEvents(const std::shared_ptr<ManifestLoad>& load) {
+    // count every event up front, callbacks for sample data which is already loaded run immediately
+    load->pendingEvents = load->manifest.events.size() + 1;
+    auto eventDone = [load](EventHandle /*event*/, bool success) {
+        if (load->unloaded)
+            return;
+        load->failed |= !success;
+        if (--load->pendingEvents == 0) {
+            load->finished = true;
+            if (load->onLoaded)
+                load->onLoaded(!load->failed);
+        }
+    };
+    for (const std::string& eventName : load->manifest.events) {
+        AudioResult<EventHandle> event = loadFMODStudioEvent(eventName.c_str());
+        if (event)
+            load->heldEvents.push_back(*event);
+        preloadEventSampleData(event.valueOr(EventHandle()), eventDone);
+    }
+    eventDone(EventHandle(), true);
+}
+
+bool AudioEngine::unloadManifest(const AudioManifest& manifest) {
+    AUDIO_TRACE_FUNCTION();
+    // the most recent load of the same manifest
+    auto found = std::find_if(manifestLoads.rbegin(), manifestLoads.rend(), [&manifest](const std::shared_ptr<ManifestLoad>& load) {
+        return load->manifest.banks == manifest.banks && load->manifest.events == manifest.events;
+    });
+    if (found == manifestLoads.rend()) {
+        AUDIO_LOG_WARNING("Audio Engine: Can't unload a manifest which isn't loaded");
+        return false;
+    }
+    std::shared_ptr<ManifestLoad> load = *found;
+    manifestLoads.erase(std::next(found).base());
+    // callbacks of loads still in progress, including the cancellations below, are ignored from here
+    load->unloaded = true;
+    for (EventHandle event : load->heldEvents)
+        unloadFMODStudioEvent(event);
+    for (const std::string& bank : load->heldBanks)
+        unloadFMODStudioBank(bank.c_str());
+    load->heldEvents.clear();
+    load->heldBanks.clear();
+    if (!load->finished && load->onLoaded)
+        load->onLoaded(false);
+    return true;
+}
+
+AudioResult<EventHandle> AudioEngine::loadFMODStudioEvent(const char* eventName, std::vector<std::pair<const char*, float>> paramsValues, int poolSize) {
+    AUDIO_TRACE_FUNCTION();
+    auto existing = eventHandles.find(eventName);
+    if (existing != eventHandles.end()) {
+        events.get(existing->second)->refCount++;
+        return existing->second;
+    }
+    AUDIO_LOG_INFO("AudioEngine: Loading FMOD Studio Event %s", eventName);
     FMOD::Studio::EventDescription* eventDescription = NULL;
-    ERRCHECK(studioSystem->getEvent(eventName, &eventDescription));
+    FMOD_RESULT result = ERRCHECK(studioSystem->getEvent(eventName, &eventDescription));
+    if (result != FMOD_OK) // not in any loaded bank
+        return result;
     // Create an instance of the event
     FMOD::Studio::EventInstance* eventInstance = NULL;
-    ERRCHECK(eventDescription->createInstance(&eventInstance));
+    result = ERRCHECK(eventDescription->createInstance(&eventInstance));
+    if (result != FMOD_OK)
+        return result;
+    EventData eventData;
+    eventData.description = eventDescription;
+    eventData.name = eventName;
+    eventData.instance = eventInstance;
+    // Resolve every parameter's ID up front, so setting parameters never needs FMOD's name lookup
+    int parameterCount = 0;
+    ERRCHECK(eventDescription->getParameterDescriptionCount(&parameterCount));
+    for (int i = 0; i < parameterCount; i++) {
+        FMOD_STUDIO_PARAMETER_DESCRIPTION parameterDescription;
+        if (eventDescription->getParameterDescriptionByIndex(i, &parameterDescription) != FMOD_OK)
+            continue;
+        eventData.parameterNames.push_back(parameterDescription.name);
+        eventData.parameterIDs.push_back(parameterDescription.id);
+        // FMOD drives read-only and automatic parameters itself, and global ones don't belong to the instance
+        if (parameterDescription.flags & (FMOD_STUDIO_PARAMETER_READONLY | FMOD_STUDIO_PARAMETER_AUTOMATIC | FMOD_STUDIO_PARAMETER_GLOBAL))
+            continue;
+        eventData.defaultParameterIDs.push_back(parameterDescription.id);
+        eventData.defaultParameterValues.push_back(parameterDescription.defaultvalue);
+    }
     for (const auto& parVal : paramsValues) {
-        std::cout << "AudioEngine: Setting Event Instance Parameter " << parVal.first << "to value: " << parVal.second << '\n';
+        AUDIO_LOG_DEBUG("AudioEngine: Setting Event Instance Parameter %s to value: %f", parVal.first, parVal.second);
         // Set the parameter values of the event instance
         ERRCHECK(eventInstance->setParameterByName(parVal.first, parVal.second));
+        int parameter = findEventParameter(eventData, parVal.first);
+        if (parameter < 0)
+            continue;
+        const FMOD_STUDIO_PARAMETER_ID& id = eventData.parameterIDs[parameter];
+        for (size_t i = 0; i < eventData.defaultParameterIDs.size(); i++)
+            if (eventData.defaultParameterIDs[i].data1 == id.data1 && eventData.defaultParameterIDs[i].data2 == id.data2)
+                eventData.defaultParameterValues[i] = parVal.second;
     }
-    eventInstances.insert({ eventName, eventInstance });
-    eventDescriptions.insert({ eventName, eventDescription });
+    EventHandle handle = events.insert(eventData);
+    eventHandles.insert({ eventName, handle });
+    if (poolSize > 0)
+        setEventPoolSize(handle, poolSize);
+    return handle;
+}
+
+void AudioEngine::unloadFMODStudioEvent(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    EventData* eventData = events.get(event);
+    if (eventData && --eventData->refCount <= 0)
+        releaseEvent(event);
+}
+
+void AudioEngine::releaseEvent(EventHandle event) {
+    EventData* eventData = events.get(event);
+    if (!eventData)
+        return;
+    AUDIO_LOG_INFO("AudioEngine: Releasing FMOD Studio Event %s", eventData->name.c_str());
+    std::vector<FMOD::Studio::EventInstance*> released;
+    released.push_back(eventData->instance);
+    released.insert(released.end(), eventData->pool.begin(), eventData->pool.end());
+    for (size_t i = 0; i < eventInstances.size(); ) {
+        if (eventInstances[i].event == event) {
+            released.push_back(eventInstances[i].instance);
+            eventInstances.erase(eventInstances.handleAt(i)); // moves the last instance to i
+        }
+        else
+            i++;
+    }
+    for (FMOD::Studio::EventInstance* instance : released) {
+        ERRCHECK(instance->stop(FMOD_STUDIO_STOP_IMMEDIATE));
+        ERRCHECK(instance->release());
+    }
+    // parameter values waiting for the released instances would be sent to invalid handles
+    pendingParameters.erase(std::remove_if(pendingParameters.begin(), pendingParameters.end(), [&released](const PendingParameter& pending) {
+        return std::find(released.begin(), released.end(), pending.instance) != released.end();
+    }), pendingParameters.end());
+
+    auto loading = std::find(loadingSampleData.begin(), loadingSampleData.end(), event);
+    if (loading != loadingSampleData.end()) {
+        *loading = loadingSampleData.back();
+        loadingSampleData.pop_back();
+    }
+    if (eventData->sampleDataRequested)
+        ERRCHECK(eventData->description->unloadSampleData());
+    std::vector<EventLoadedCallback> onLoaded;
+    onLoaded.swap(eventData->onSampleDataLoaded);
+    eventHandles.erase(eventData->name);
+    events.erase(event);
+    for (const EventLoadedCallback& callback : onLoaded)
+        callback(event, false);
+}
+
+EventHandle AudioEngine::getEventHandle(const char* eventName) {
+    AUDIO_TRACE_FUNCTION();
+    auto it = eventHandles.find(eventName);
+    return it != eventHandles.end() ? it->second : EventHandle();
 }
 
 void AudioEngine::setFMODEventParamValue(const char* eventName, const char* parameterName, float value) {
-    if (eventInstances.count(eventName) > 0)
-        ERRCHECK(eventInstances[eventName]->setParameterByName(parameterName, value));
+    AUDIO_TRACE_FUNCTION();
+    setFMODEventParamValue(getEventHandle(eventName), parameterName, value);
+}
+
+void AudioEngine::setFMODEventParamValue(EventHandle event, const char* parameterName, float value) {
+    AUDIO_TRACE_FUNCTION();
+    if (EventData* eventData = events.get(event))
+        setEventParameter(*eventData, eventData->instance, parameterName, value);
     else
-        std::cout << "AudioEngine: Event " << eventName << " was not in event instance cache, can't set param \n";
+        AUDIO_LOG_WARNING("AudioEngine: Event was not in event instance cache, can't set param");
+
+}
+
+EventParameterHandle AudioEngine::getEventParameterHandle(EventHandle event, const char* parameterName) {
+    AUDIO_TRACE_FUNCTION();
+    EventParameterHandle parameter;
+    EventData* eventData = events.get(event);
+    if (!eventData)
+        return parameter;
+    int index = findEventParameter(*eventData, parameterName);
+    if (index < 0) {
+        AUDIO_LOG_WARNING("AudioEngine: Event has no parameter %s", parameterName);
+        return parameter;
+    }
+    parameter.event = event;
+    parameter.index = uint32_t(index);
+    return parameter;
+}
 
+void AudioEngine::setFMODEventParamValue(EventParameterHandle parameter, float value) {
+    AUDIO_TRACE_FUNCTION();
+    EventData* eventData = events.get(parameter.event);
+    if (!eventData || parameter.index >= eventData->parameterIDs.size())
+        return;
+    PendingParameter pending;
+    pending.instance = eventData->instance;
+    pending.id = eventData->parameterIDs[parameter.index];
+    pending.value = value;
+    pendingParameters.push_back(pending);
+}
+
+int AudioEngine::findEventParameter(const EventData& eventData, const char* parameterName) {
+    for (size_t i = 0; i < eventData.parameterNames.size(); i++)
+        if (eventData.parameterNames[i] == parameterName)
+            return int(i);
+    return -1;
+}
+
+void AudioEngine::setEventParameter(const EventData& eventData, FMOD::Studio::EventInstance* instance, const char* parameterName, float value) {
+    PendingParameter pending;
+    pending.instance = instance;
+    int index = findEventParameter(eventData, parameterName);
+    if (index >= 0)
+        pending.id = eventData.parameterIDs[index];
+    else {
+        // FMOD matches names case insensitively, so the name may still resolve. Queuing the write rather than
+        // setting it by name keeps it in order with the values already waiting for the instance
+        FMOD_STUDIO_PARAMETER_DESCRIPTION parameterDescription;
+        if (ERRCHECK(eventData.description->getParameterDescriptionByName(parameterName, &parameterDescription)) != FMOD_OK)
+            return;
+        pending.id = parameterDescription.id;
+    }
+    pending.value = value;
+    pendingParameters.push_back(pending);
+}
+
+void AudioEngine::flushEventParameters() {
+    if (pendingParameters.empty())
+        return;
+    // group by instance, keeping the order values were set in within each instance
+    std::stable_sort(pendingParameters.begin(), pendingParameters.end(), [](const PendingParameter& a, const PendingParameter& b) {
+        return a.instance < b.instance;
+    });
+    size_t runStart = 0;
+    while (runStart < pendingParameters.size()) {
+        FMOD::Studio::EventInstance* instance = pendingParameters[runStart].instance;
+        size_t runEnd = runStart;
+        while (runEnd < pendingParameters.size() && pendingParameters[runEnd].instance == instance)
+            runEnd++;
+        // walk the run backwards so only the last value set for each parameter is sent
+        parameterBatchIDs.clear();
+        parameterBatchValues.clear();
+        for (size_t i = runEnd; i-- > runStart;) {
+            const FMOD_STUDIO_PARAMETER_ID& id = pendingParameters[i].id;
+            bool alreadySet = false;
+            for (const FMOD_STUDIO_PARAMETER_ID& batched : parameterBatchIDs)
+                alreadySet |= batched.data1 == id.data1 && batched.data2 == id.data2;
+            if (alreadySet)
+                continue;
+            parameterBatchIDs.push_back(id);
+            parameterBatchValues.push_back(pendingParameters[i].value);
+        }
+        ERRCHECK(instance->setParametersByIDs(parameterBatchIDs.data(), parameterBatchValues.data(), int(parameterBatchIDs.size())));
+        runStart = runEnd;
+    }
+    pendingParameters.clear();
 }
 
 void AudioEngine::playEvent(const char* eventName, int instanceIndex) {
+    AUDIO_TRACE_FUNCTION();
     // printEventInfo(eventDescriptions[eventName]);
-    auto eventInstance = eventInstances[eventName];
-    if (eventInstances.count(eventName) > 0)
-        ERRCHECK(eventInstances[eventName]->start());
-    else
-        std::cout << "AudioEngine: Event " << eventName << " was not in event instance cache, cannot play \n";
+    playEvent(getEventHandle(eventName));
+}
+
+FMOD_RESULT AudioEngine::playEvent(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    if (EventData* eventData = events.get(event))
+        return ERRCHECK(eventData->instance->start());
+    AUDIO_LOG_WARNING("AudioEngine: Event was not in event instance cache, cannot play");
+    return FMOD_ERR_INVALID_HANDLE;
 }
 
 void AudioEngine::stopEvent(const char* eventName, int instanceIndex) {
-    if (eventInstances.count(eventName) > 0)
-        ERRCHECK(eventInstances[eventName]->stop(FMOD_STUDIO_STOP_ALLOWFADEOUT));
-    else
-        std::cout << "AudioEngine: Event " << eventName << " was not in event instance cache, cannot stop \n";
+    AUDIO_TRACE_FUNCTION();
+    stopEvent(getEventHandle(eventName));
+}
+
+FMOD_RESULT AudioEngine::stopEvent(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    if (EventData* eventData = events.get(event))
+        return ERRCHECK(eventData->instance->stop(FMOD_STUDIO_STOP_ALLOWFADEOUT));
+    AUDIO_LOG_WARNING("AudioEngine: Event was not in event instance cache, cannot stop");
+    return FMOD_ERR_INVALID_HANDLE;
 }
 
 void AudioEngine::setEventVolume(const char* eventName, float volume0to1) {
-    std::cout << "AudioEngine: Setting Event Volume\n";
-    ERRCHECK(eventInstances[eventName]->setVolume(volume0to1));
+    AUDIO_TRACE_FUNCTION();
+    setEventVolume(getEventHandle(eventName), volume0to1);
+}
+
+FMOD_RESULT AudioEngine::setEventVolume(EventHandle event, float volume0to1) {
+    AUDIO_TRACE_FUNCTION();
+    AUDIO_LOG_DEBUG("AudioEngine: Setting Event Volume %f", volume0to1);
+    if (EventData* eventData = events.get(event))
+        return ERRCHECK(eventData->instance->setVolume(volume0to1));
+    return FMOD_ERR_INVALID_HANDLE;
 }
 
 bool AudioEngine::eventIsPlaying(const char* eventName, int instance /*= 0*/) {
+    AUDIO_TRACE_FUNCTION();
+    return eventIsPlaying(getEventHandle(eventName));
+}
+
+void AudioEngine::setEventPoolSize(EventHandle event, int poolSize) {
+    AUDIO_TRACE_FUNCTION();
+    EventData* eventData = events.get(event);
+    if (!eventData)
+        return;
+    // new instances only, taking one from the pool to put it back wouldn't grow it
+    while (int(eventData->pool.size()) < poolSize) {
+        FMOD::Studio::EventInstance* instance = nullptr;
+        if (createPooledInstance(*eventData, &instance) != FMOD_OK)
+            return;
+        eventData->pool.push_back(instance);
+    }
+}
+
+FMOD_RESULT AudioEngine::createPooledInstance(EventData& eventData, FMOD::Studio::EventInstance** instance) {
+    FMOD_RESULT result = ERRCHECK(eventData.description->createInstance(instance));
+    if (result != FMOD_OK)
+        return result;
+    ERRCHECK((*instance)->setCallback(eventCallback, FMOD_STUDIO_EVENT_CALLBACK_STOPPED | FMOD_STUDIO_EVENT_CALLBACK_START_FAILED));
+    return FMOD_OK;
+}
+
+FMOD_RESULT AudioEngine::takePooledInstance(EventData& eventData, FMOD::Studio::EventInstance** pooled) {
+    FMOD::Studio::EventInstance* instance = nullptr;
+    if (eventData.pool.empty()) {
+        FMOD_RESULT result = createPooledInstance(eventData, &instance);
+        if (result != FMOD_OK)
+            return result;
+    }
+    else {
+        instance = eventData.pool.back();
+        eventData.pool.pop_back();
+    }
+    // recycled instances keep the parameter values of their last use, so every parameter is put back to its default
+    if (!eventData.defaultParameterIDs.empty()) {
+        parameterBatchValues.assign(eventData.defaultParameterValues.begin(), eventData.defaultParameterValues.end());
+        ERRCHECK(instance->setParametersByIDs(eventData.defaultParameterIDs.data(), parameterBatchValues.data(),
+                                              int(eventData.defaultParameterIDs.size())));
+    }
+    *pooled = instance;
+    return FMOD_OK;
+}
+
+static FMOD_3D_ATTRIBUTES eventAttributes(Vec3 position) {
+    FMOD_3D_ATTRIBUTES attributes = { };
+    attributes.position = { position.x, position.y, position.z };
+    attributes.forward = { 0.0f, 0.0f, 1.0f };
+    attributes.up = { 0.0f, 1.0f, 0.0f };
+    return attributes;
+}
+
+AudioResult<EventInstanceHandle> AudioEngine::playEventInstance(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    return startEventInstance(event, nullptr);
+}
+
+AudioResult<EventInstanceHandle> AudioEngine::playEventInstance(EventHandle event, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    return startEventInstance(event, &position);
+}
+
+AudioResult<EventInstanceHandle> AudioEngine::startEventInstance(EventHandle event, const Vec3* position) {
+    EventData* eventData = events.get(event);
+    if (!eventData) {
+        AUDIO_LOG_WARNING("AudioEngine: Event was not in event instance cache, cannot play");
+        return FMOD_ERR_INVALID_HANDLE;
+    }
+    EventInstanceData instanceData;
+    FMOD_RESULT result = takePooledInstance(*eventData, &instanceData.instance);
+    instanceData.event = event;
+    if (result != FMOD_OK)
+        return result;
+    if (position) { // positioned before starting, so the first mix is already spatialized
+        FMOD_3D_ATTRIBUTES attributes = eventAttributes(*position);
+        ERRCHECK(instanceData.instance->set3DAttributes(&attributes));
+    }
+    EventInstanceHandle handle = eventInstances.insert(instanceData);
+    ERRCHECK(instanceData.instance->setUserData(reinterpret_cast<void*>(uintptr_t(handle.index))));
+    result = ERRCHECK(instanceData.instance->start());
+    if (result != FMOD_OK) { // an instance which never started won't report stopping
+        recycleEventInstance(handle);
+        return result;
+    }
+    return handle;
+}
+
+FMOD_RESULT AudioEngine::stopEventInstance(EventInstanceHandle instance, bool immediate) {
+    AUDIO_TRACE_FUNCTION();
+    // the instance returns to the pool once FMOD reports it stopped, after any fade out
+    if (EventInstanceData* instanceData = eventInstances.get(instance))
+        return ERRCHECK(instanceData->instance->stop(immediate ? FMOD_STUDIO_STOP_IMMEDIATE : FMOD_STUDIO_STOP_ALLOWFADEOUT));
+    return FMOD_ERR_INVALID_HANDLE;
+}
+
+void AudioEngine::setEventInstanceParamValue(EventInstanceHandle instance, const char* parameterName, float value) {
+    AUDIO_TRACE_FUNCTION();
+    EventInstanceData* instanceData = eventInstances.get(instance);
+    if (!instanceData)
+        return;
+    if (EventData* eventData = events.get(instanceData->event))
+        setEventParameter(*eventData, instanceData->instance, parameterName, value);
+}
+
+void AudioEngine::setEventInstanceParamValue(EventInstanceHandle instance, EventParameterHandle parameter, float value) {
+    AUDIO_TRACE_FUNCTION();
+    EventInstanceData* instanceData = eventInstances.get(instance);
+    if (!instanceData || !(instanceData->event == parameter.event))
+        return;
+    EventData* eventData = events.get(parameter.event);
+    if (!eventData || parameter.index >= eventData->parameterIDs.size())
+        return;
+    PendingParameter pending;
+    pending.instance = instanceData->instance;
+    pending.id = eventData->parameterIDs[parameter.index];
+    pending.value = value;
+    pendingParameters.push_back(pending);
+}
+
+FMOD_RESULT AudioEngine::setEventInstanceVolume(EventInstanceHandle instance, float volume0to1) {
+    AUDIO_TRACE_FUNCTION();
+    if (EventInstanceData* instanceData = eventInstances.get(instance))
+        return ERRCHECK(instanceData->instance->setVolume(volume0to1));
+    return FMOD_ERR_INVALID_HANDLE;
+}
+
+FMOD_RESULT AudioEngine::set3DEventInstancePosition(EventInstanceHandle instance, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    EventInstanceData* instanceData = eventInstances.get(instance);
+    if (!instanceData)
+        return FMOD_ERR_INVALID_HANDLE;
+    FMOD_3D_ATTRIBUTES attributes = eventAttributes(position);
+    return ERRCHECK(instanceData->instance->set3DAttributes(&attributes));
+}
+
+bool AudioEngine::eventInstanceIsPlaying(EventInstanceHandle instance) {
+    AUDIO_TRACE_FUNCTION();
+    EventInstanceData* instanceData = eventInstances.get(instance);
+    if (!instanceData)
+        return false;
     FMOD_STUDIO_PLAYBACK_STATE playbackState;
-    ERRCHECK(eventInstances[eventName]->getPlaybackState(&playbackState));
+    ERRCHECK(instanceData->instance->getPlaybackState(&playbackState));
+    return playbackState != FMOD_STUDIO_PLAYBACK_STOPPED;
+}
+
+void AudioEngine::processStoppedEventInstances() {
+    StoppedEventInstance stopped;
+    while (stoppedEventInstances.pop(stopped)) {
+        EventInstanceHandle handle = eventInstances.handleForIndex(stopped.instanceIndex);
+        EventInstanceData* instanceData = eventInstances.get(handle);
+        if (!instanceData || instanceData->instance != stopped.instance)
+            continue;
+        recycleEventInstance(handle);
+    }
+    // a notification dropped because the queue was full would leave its instance out of the pool for good
+    if (stoppedEventsDropped.exchange(false, std::memory_order_acquire)) {
+        for (size_t i = 0; i < eventInstances.size(); ) {
+            FMOD_STUDIO_PLAYBACK_STATE playbackState = FMOD_STUDIO_PLAYBACK_PLAYING;
+            ERRCHECK(eventInstances[i].instance->getPlaybackState(&playbackState));
+            if (playbackState == FMOD_STUDIO_PLAYBACK_STOPPED)
+                recycleEventInstance(eventInstances.handleAt(i)); // moves the last instance to i
+            else
+                i++;
+        }
+    }
+}
+
+void AudioEngine::recycleEventInstance(EventInstanceHandle handle) {
+    EventInstanceData* instanceData = eventInstances.get(handle);
+    FMOD::Studio::EventInstance* instance = instanceData->instance;
+    // values set through the old handle would otherwise reach the instance's next use
+    pendingParameters.erase(std::remove_if(pendingParameters.begin(), pendingParameters.end(), [instance](const PendingParameter& pending) {
+        return pending.instance == instance;
+    }), pendingParameters.end());
+    if (EventData* eventData = events.get(instanceData->event))
+        eventData->pool.push_back(instance);
+    else
+        ERRCHECK(instance->release());
+    eventInstances.erase(handle);
+}
+
+FMOD_RESULT F_CALL AudioEngine::eventCallback(FMOD_STUDIO_EVENT_CALLBACK_TYPE /*type*/, FMOD_STUDIO_EVENTINSTANCE* event, void* /*parameters*/) {
+    if (!callbackEngine)
+        return FMOD_OK;
+    FMOD::Studio::EventInstance* instance = reinterpret_cast<FMOD::Studio::EventInstance*>(event);
+    void* userData = nullptr;
+    instance->getUserData(&userData);
+    StoppedEventInstance stopped;
+    stopped.instanceIndex = uint32_t(reinterpret_cast<uintptr_t>(userData));
+    stopped.instance = instance;
+    // if the queue is full, update() finds the instance by its playback state instead
+    if (!callbackEngine->stoppedEventInstances.push(stopped))
+        callbackEngine->stoppedEventsDropped.store(true, std::memory_order_release);
+    AUDIO_TRACE_INSTANT("Event instance stopped");
+    return FMOD_OK;
+}
+
+bool AudioEngine::eventIsPlaying(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    EventData* eventData = events.get(event);
+    if (!eventData)
+        return false;
+    FMOD_STUDIO_PLAYBACK_STATE playbackState;
+    ERRCHECK(eventData->instance->getPlaybackState(&playbackState));
     return playbackState == FMOD_STUDIO_PLAYBACK_PLAYING;
 }
 
 
+bool AudioEngine::queuePlaySound(SoundHandle sound, float volume, float reverbAmount, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    Command command;
+    command.type = Command::PLAY_SOUND;
+    command.sound = sound;
+    command.value = volume;
+    command.reverbAmount = reverbAmount;
+    command.position = position;
+    return commands.push(command);
+}
+
+bool AudioEngine::queueStopSound(VoiceHandle voice) {
+    AUDIO_TRACE_FUNCTION();
+    Command command;
+    command.type = Command::STOP_SOUND;
+    command.voice = voice;
+    return commands.push(command);
+}
+
+bool AudioEngine::queueSoundVolume(VoiceHandle voice, float newVolume, unsigned int fadeSampleLength) {
+    AUDIO_TRACE_FUNCTION();
+    Command command;
+    command.type = Command::SET_VOLUME;
+    command.voice = voice;
+    command.value = newVolume;
+    command.fadeSampleLength = fadeSampleLength;
+    return commands.push(command);
+}
+
+bool AudioEngine::queue3DSoundPosition(VoiceHandle voice, Vec3 position) {
+    AUDIO_TRACE_FUNCTION();
+    Command command;
+    command.type = Command::SET_3D_POSITION;
+    command.voice = voice;
+    command.position = position;
+    return commands.push(command);
+}
+
+bool AudioEngine::queuePlayEvent(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    Command command;
+    command.type = Command::PLAY_EVENT;
+    command.event = event;
+    return commands.push(command);
+}
+
+bool AudioEngine::queueStopEvent(EventHandle event) {
+    AUDIO_TRACE_FUNCTION();
+    Command command;
+    command.type = Command::STOP_EVENT;
+    command.event = event;
+    return commands.push(command);
+}
+
+bool AudioEngine::queueEventParamValue(EventHandle event, const char* parameterName, float value) {
+    AUDIO_TRACE_FUNCTION();
+    if (!parameterName)
+        return false;
+    size_t nameLength = strlen(parameterName);
+    if (nameLength >= MAX_QUEUED_PARAM_NAME)
+        return false;
+    Command command;
+    command.type = Command::SET_EVENT_PARAM;
+    command.event = event;
+    command.value = value;
+    memcpy(command.parameterName, parameterName, nameLength + 1);
+    return commands.push(command);
+}
+
 void AudioEngine::muteAllSounds() {
+    AUDIO_TRACE_FUNCTION();
     ERRCHECK(mastergroup->setMute(true));
     muted = true;
 }
 
 void AudioEngine::unmuteAllSound() {
+    AUDIO_TRACE_FUNCTION();
     ERRCHECK(mastergroup->setMute(false));
     muted = false;
 }
 
 bool AudioEngine::isMuted() {
+    AUDIO_TRACE_FUNCTION();
     return muted;
 }
 
 // Private definitions 
 bool AudioEngine::soundLoaded(SoundInfo soundInfo) {
-    //std::cout << "Checking sound " << soundInfo.getUniqueID() << " exists\n";
-    return sounds.count(soundInfo.getUniqueID()) > 0;
+    //AUDIO_LOG_DEBUG("Checking sound %s exists", soundInfo.getUniqueID().c_str());
+    return soundHandles.count(soundInfo.getUniqueID()) > 0;
+}
+
+AudioResult<SoundHandle> AudioEngine::createSound(SoundInfo& soundInfo, bool nonBlocking, SoundLoadPolicy policy) {
+    AUDIO_TRACE_FUNCTION();
+    policy = resolveLoadPolicy(soundInfo.getFilePath(), policy);
+    FMOD_MODE mode = soundInfo.is3D() ? FMOD_3D : FMOD_2D;
+    mode |= soundInfo.isLoop() ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
+    if (nonBlocking)
+        mode |= FMOD_NONBLOCKING;
+    if (policy == SoundLoadPolicy::COMPRESSED)
+        mode |= FMOD_CREATECOMPRESSEDSAMPLE;
+    else if (policy == SoundLoadPolicy::STREAM)
+        mode |= FMOD_CREATESTREAM;
+    // files in a mounted pack are opened straight from its mapping, the file callbacks only serve the rest
+    FMOD_CREATESOUNDEXINFO exinfo = { };
+    exinfo.cbsize = sizeof(FMOD_CREATESOUNDEXINFO);
+    unsigned int packedSize = 0;
+    const unsigned char* packed = packFileSystem.find(soundInfo.getFilePath(), &packedSize);
+    if (packed) {
+        mode |= FMOD_OPENMEMORY_POINT;
+        exinfo.length = packedSize;
+    }
+    const char* source = packed ? reinterpret_cast<const char*>(packed) : soundInfo.getFilePath();
+    FMOD::Sound* sound = nullptr;
+    FMOD_RESULT result = ERRCHECK(lowLevelSystem->createSound(source, mode, packed ? &exinfo : 0, &sound));
+    if (result != FMOD_OK)
+        return result;
+
+    SoundData soundData;
+    soundData.sound = sound;
+    soundData.is3D = soundInfo.is3D();
+    soundData.isLoop = soundInfo.isLoop();
+    soundData.policy = policy;
+    if (policy == SoundLoadPolicy::STREAM) {
+        // a stream has one decode position, so a new voice restarts it in place of the old one
+        soundData.maxInstances = 1;
+        soundData.stealPolicy = VoiceStealPolicy::OLDEST;
+    }
+    soundData.refCount = 1;
+    soundData.uniqueID = soundInfo.getUniqueID();
+    SoundHandle handle = sounds.insert(soundData);
+    sounds.get(handle)->lruPosition = soundLRU.insert(soundLRU.begin(), handle);
+    soundHandles.insert({ soundInfo.getUniqueID(), handle });
+    return handle;
 }
 
-void AudioEngine::set3dChannelPosition(SoundInfo soundInfo, FMOD::Channel* channel) {
-    FMOD_VECTOR position = { soundInfo.getX() * DISTANCEFACTOR, soundInfo.getY() * DISTANCEFACTOR, soundInfo.getZ() * DISTANCEFACTOR };
-    FMOD_VECTOR velocity = { 0.0f, 0.0f, 0.0f }; // TODO Add dopplar (velocity) support
-    ERRCHECK(channel->set3DAttributes(&position, &velocity));
+SoundLoadPolicy AudioEngine::resolveLoadPolicy(const char* filePath, SoundLoadPolicy policy) {
+    if (policy != SoundLoadPolicy::AUTO)
+        return policy;
+    unsigned long long fileSize = 0;
+    if (!packFileSystem.getFileSize(filePath, &fileSize)) // let FMOD report the problem when it tries to open the file
+        return SoundLoadPolicy::DECOMPRESSED;
+    if (fileSize < compressedThresholdBytes)
+        return SoundLoadPolicy::DECOMPRESSED;
+    return fileSize < streamThresholdBytes ? SoundLoadPolicy::COMPRESSED : SoundLoadPolicy::STREAM;
 }
 
-void AudioEngine::initReverb() {
-    ERRCHECK(lowLevelSystem->createReverb3D(&reverb));
-    FMOD_REVERB_PROPERTIES prop2 = FMOD_PRESET_CONCERTHALL;
-    ERRCHECK(reverb->setProperties(&prop2));
-    ERRCHECK(reverb->set3DAttributes(&revPos, revMinDist, revMaxDist));
+void AudioEngine::finishLoadingSound(SoundData& soundData) {
+    ERRCHECK(soundData.sound->set3DMinMaxDistance(soundData.minDistance * DISTANCEFACTOR, soundData.maxDistance * DISTANCEFACTOR));
+    soundData.loadState = SoundLoadState::READY;
+    soundData.memoryBytes = estimateSoundMemory(soundData);
+    soundMemoryUsed += soundData.memoryBytes;
 }
 
-// Error checking/debugging function definitions
+unsigned long long AudioEngine::estimateSoundMemory(const SoundData& soundData) {
+    int channels = 0, bits = 0;
+    ERRCHECK(soundData.sound->getFormat(0, 0, &channels, &bits));
+    unsigned int length = 0;
+    switch (soundData.policy) {
+    case SoundLoadPolicy::STREAM: {
+        // streams only hold their file buffer and decode buffer, FMOD defaults to 16KB and 400ms
+        float frequency = 0.0f;
+        ERRCHECK(soundData.sound->getDefaults(&frequency, 0));
+        return 16 * 1024 + (unsigned long long)(frequency * 0.4f) * channels * (bits / 8);
+    }
+    case SoundLoadPolicy::COMPRESSED:
+        ERRCHECK(soundData.sound->getLength(&length, FMOD_TIMEUNIT_RAWBYTES));
+        return length;
+    default:
+        ERRCHECK(soundData.sound->getLength(&length, FMOD_TIMEUNIT_PCMBYTES));
+        return length;
+    }
+}
+
+VoiceHandle AudioEngine::addVoice(const VoiceData& voiceData, bool is3D, Vec3 position) {
+    if (SoundData* soundData = sounds.get(voiceData.sound))
+        soundData->activeVoices++;
+    getVoiceCategory(voiceData.category).activeVoices++;
+    VoiceHandle voice = voices.insert(voiceData);
+    if (is3D)
+        voices.get(voice)->emitter = emitters.add(voice, position);
+    return voice;
+}
+
+Vec3 AudioEngine::getVoicePosition(const VoiceData& voiceData) {
+    return voiceData.emitter != EmitterStore::NO_EMITTER ? emitters.getPosition(voiceData.emitter) : Vec3();
+}
+
+void AudioEngine::removeVoice(VoiceHandle voice) {
+    VoiceData* voiceData = voices.get(voice);
+    if (!voiceData)
+        return;
+    if (SoundData* soundData = sounds.get(voiceData->sound))
+        soundData->activeVoices--;
+    voiceCategories[voiceData->category].activeVoices--;
+    if (voiceData->emitter != EmitterStore::NO_EMITTER) {
+        // the last emitter is moved into the removed one's place, point its voice at the new index
+        VoiceHandle moved = emitters.remove(voiceData->emitter);
+        if (VoiceData* movedData = voices.get(moved))
+            movedData->emitter = voiceData->emitter;
+    }
+    voices.erase(voice);
+}
+
+void AudioEngine::touchSound(SoundData& soundData) {
+    soundLRU.splice(soundLRU.begin(), soundLRU, soundData.lruPosition);
+}
 
-void ERRCHECK_fn(FMOD_RESULT result, const char* file, int line) {
+bool AudioEngine::soundIsEvictable(const SoundData& soundData) {
+    return soundData.refCount == 0 && soundData.activeVoices == 0 && soundData.loadState != SoundLoadState::LOADING;
+}
+
+void AudioEngine::evictSound(SoundHandle sound) {
+    SoundData* soundData = sounds.get(sound);
+    if (!soundData)
+        return;
+    ERRCHECK(soundData->sound->release());
+    soundMemoryUsed -= soundData->memoryBytes;
+    soundLRU.erase(soundData->lruPosition);
+    soundHandles.erase(soundData->uniqueID);
+    sounds.erase(sound);
+}
+
+void AudioEngine::enforceSoundMemoryBudget() {
+    if (soundMemoryBudget == 0 || soundMemoryUsed <= soundMemoryBudget)
+        return;
+    // walk from the least recently used end
+    for (auto it = soundLRU.end(); it != soundLRU.begin() && soundMemoryUsed > soundMemoryBudget; ) {
+        --it;
+        SoundHandle sound = *it;
+        if (soundIsEvictable(*sounds.get(sound))) {
+            it = std::next(it); // evictSound erases this node, so continue from its successor
+            evictSound(sound);
+        }
+    }
+}
+
+void AudioEngine::updateLoadingBanks() {
+    for (size_t i = 0; i < unloadingBanks.size(); ) {
+        FMOD_STUDIO_LOADING_STATE state;
+        // once the bank is gone its handle is invalid, either way FMOD no longer reads the mapping
+        FMOD_RESULT result = unloadingBanks[i].bank->getLoadingState(&state);
+        if (result == FMOD_OK && state != FMOD_STUDIO_LOADING_STATE_UNLOADED) {
+            i++;
+            continue;
+        }
+        unloadingBanks[i] = std::move(unloadingBanks.back());
+        unloadingBanks.pop_back();
+    }
+
+    for (size_t i = 0; i < loadingBanks.size(); ) {
+        LoadingBank& loadingBank = loadingBanks[i];
+        FMOD_STUDIO_LOADING_STATE state;
+        // like getOpenState, getLoadingState returns the error which made the bank fail to load
+        FMOD_RESULT result = loadingBank.bank->getLoadingState(&state);
+        bool failed = result != FMOD_OK || state == FMOD_STUDIO_LOADING_STATE_ERROR;
+        if (!failed && state == FMOD_STUDIO_LOADING_STATE_LOADED && loadingBank.preloadSampleData) {
+            if (!loadingBank.sampleDataRequested) {
+                ERRCHECK(loadingBank.bank->loadSampleData());
+                loadingBank.sampleDataRequested = true;
+            }
+            result = loadingBank.bank->getSampleLoadingState(&state);
+            failed = result != FMOD_OK || state == FMOD_STUDIO_LOADING_STATE_ERROR;
+        }
+        if (!failed && state != FMOD_STUDIO_LOADING_STATE_LOADED) {
+            i++;
+            continue;
+        }
+        // take the bank out of the list first, callbacks may load more banks
+        LoadingBank finished = loadingBank;
+        loadingBanks[i] = loadingBanks.back();
+        loadingBanks.pop_back();
+        AUDIO_TRACE_INSTANT(failed ? "Bank load failed" : "Bank loaded");
+        if (failed) {
+            ERRCHECK(result);
+            AUDIO_LOG_ERROR("Audio Engine: Failed to load bank %s", finished.filePath.c_str());
+            auto failedBank = soundBanks.find(finished.filePath);
+            if (failedBank != soundBanks.end()) {
+                beginUnloadingBank(failedBank->second);
+                soundBanks.erase(failedBank);
+            }
+        }
+        for (const BankLoadedCallback& callback : finished.onLoaded)
+            callback(finished.filePath, !failed);
+    }
+
+    for (size_t i = 0; i < loadingSampleData.size(); ) {
+        EventHandle event = loadingSampleData[i];
+        EventData* eventData = events.get(event);
+        FMOD_STUDIO_LOADING_STATE state = FMOD_STUDIO_LOADING_STATE_ERROR;
+        if (eventData)
+            ERRCHECK(eventData->description->getSampleLoadingState(&state));
+        if (state != FMOD_STUDIO_LOADING_STATE_LOADED && state != FMOD_STUDIO_LOADING_STATE_ERROR) {
+            i++;
+            continue;
+        }
+        loadingSampleData[i] = loadingSampleData.back();
+        loadingSampleData.pop_back();
+        if (!eventData)
+            continue;
+        std::vector<EventLoadedCallback> onLoaded;
+        onLoaded.swap(eventData->onSampleDataLoaded);
+        bool success = state == FMOD_STUDIO_LOADING_STATE_LOADED;
+        if (!success)
+            AUDIO_LOG_ERROR("Audio Engine: Failed to load event sample data");
+        for (const EventLoadedCallback& callback : onLoaded)
+            callback(event, success);
+    }
+}
+
+void AudioEngine::updateLoadingSounds() {
+    for (size_t i = 0; i < loadingSounds.size(); ) {
+        SoundHandle handle = loadingSounds[i];
+        SoundData* soundData = sounds.get(handle);
+        if (!soundData) { // removed while loading
+            loadingSounds[i] = loadingSounds.back();
+            loadingSounds.pop_back();
+            continue;
+        }
+        // a completed sound is removed from loadingSounds, leaving another at i
+        if (completeSoundLoad(handle) == FMOD_ERR_NOTREADY)
+            i++;
+    }
+}
+
+FMOD_RESULT AudioEngine::completeSoundLoad(SoundHandle handle) {
+    SoundData* soundData = sounds.get(handle);
+    FMOD_OPENSTATE openState;
+    // getOpenState returns the result of the failed open if loading failed
+    FMOD_RESULT result = soundData->sound->getOpenState(&openState, 0, 0, 0);
+    bool failed = result != FMOD_OK || openState == FMOD_OPENSTATE_ERROR;
+    if (!failed && openState != FMOD_OPENSTATE_READY)
+        return FMOD_ERR_NOTREADY;
+    auto loading = std::find(loadingSounds.begin(), loadingSounds.end(), handle);
+    if (loading != loadingSounds.end()) {
+        *loading = loadingSounds.back();
+        loadingSounds.pop_back();
+    }
+
+    // take the queued work out of the sound first, starting channels and callbacks may modify the sound cache
+    std::vector<VoiceHandle> pendingVoices;
+    std::vector<SoundLoadedCallback> onLoaded;
+    pendingVoices.swap(soundData->pendingVoices);
+    onLoaded.swap(soundData->onLoaded);
+
+    AUDIO_TRACE_INSTANT(failed ? "Sound open failed" : "Sound opened");
+    if (failed) {
+        ERRCHECK(result);
+        AUDIO_LOG_ERROR("Audio Engine: Failed to load sound %s", soundData->uniqueID.c_str());
+        for (VoiceHandle voice : pendingVoices)
+            removeVoice(voice);
+        evictSound(handle);
+    }
+    else {
+        finishLoadingSound(*soundData);
+        // voices stopped while the sound was loading are already gone, startVoice() skips them
+        for (VoiceHandle voice : pendingVoices)
+            if (voices.contains(voice) && startVoice(voice) != FMOD_OK)
+                removeVoice(voice);
+    }
+    for (const SoundLoadedCallback& callback : onLoaded)
+        callback(handle, !failed);
+    return failed ? (result != FMOD_OK ? result : FMOD_ERR_FILE_BAD) : FMOD_OK;
+}
+
+FMOD_RESULT AudioEngine::startVoice(VoiceHandle voice) {
+    VoiceData* voiceData = voices.get(voice);
+    const SoundData* soundData = voiceData ? sounds.get(voiceData->sound) : nullptr;
+    if (!soundData)
+        return FMOD_ERR_INVALID_HANDLE;
+    FMOD::Channel* channel = nullptr;
+    // start play in 'paused' state
+    FMOD_RESULT result = ERRCHECK(lowLevelSystem->playSound(soundData->sound, 0, true /* start paused */, &channel));
     if (result != FMOD_OK)
-        std::cout << "FMOD ERROR: AudioEngine.cpp [Line " << line << "] " << result << "  - " << FMOD_ErrorString(result) << '\n';
+        return result;
+
+    if (voiceData->emitter != EmitterStore::NO_EMITTER) {
+        set3dChannelPosition(emitters.getPosition(voiceData->emitter), emitters.getVelocity(voiceData->emitter), channel);
+        emitters.clearDirty(voiceData->emitter);
+    }
+
+    ERRCHECK(channel->setVolume(voiceData->volume));
+    ERRCHECK(channel->setReverbProperties(0, voiceData->reverbAmount));
+    ERRCHECK(channel->setPriority(voiceData->priority));
+
+    // the END callback removes the voice, it finds it again through the slot index
+    ERRCHECK(channel->setUserData(reinterpret_cast<void*>(uintptr_t(voice.index))));
+    ERRCHECK(channel->setCallback(channelCallback));
+    voiceData->channel = channel;
+
+    // start audio playback
+    ERRCHECK(channel->setPaused(false));
+    return FMOD_OK;
+}
+
+bool AudioEngine::enforceVoiceLimits(SoundHandle sound, const SoundData& soundData) {
+    int priority = soundData.priority;
+    if (soundData.maxInstances > 0 && soundData.activeVoices >= soundData.maxInstances) {
+        VoiceHandle victim = findVoiceToSteal(sound, -1, soundData.stealPolicy, priority);
+        if (!victim.isValid())
+            return false;
+        stopSound(victim);
+    }
+    // stealing within the sound may already have made room in the category
+    const SoundData* current = sounds.get(sound);
+    VoiceCategory& voiceCategory = getVoiceCategory(current->category);
+    if (voiceCategory.maxInstances > 0 && voiceCategory.activeVoices >= voiceCategory.maxInstances) {
+        VoiceHandle victim = findVoiceToSteal(SoundHandle(), current->category, voiceCategory.stealPolicy, priority);
+        if (!victim.isValid())
+            return false;
+        stopSound(victim);
+    }
+    return true;
+}
+
+VoiceHandle AudioEngine::findVoiceToSteal(SoundHandle sound, int category, VoiceStealPolicy policy, int newPriority) {
+    if (policy == VoiceStealPolicy::NONE)
+        return VoiceHandle();
+    VoiceHandle victim;
+    float victimScore = 0.0f;
+    unsigned long long victimStartOrder = 0;
+    for (size_t i = 0; i < voices.size(); i++) {
+        const VoiceData& voiceData = voices[i];
+        if (category < 0 ? voiceData.sound != sound : voiceData.category != category)
+            continue;
+        // a higher score makes a better victim, ties go to the older voice
+        float score = 0.0f;
+        switch (policy) {
+        case VoiceStealPolicy::QUIETEST: {
+            float audibility = voiceData.volume;
+            if (voiceData.channel)
+                voiceData.channel->getAudibility(&audibility);
+            score = -audibility;
+            break;
+        }
+        case VoiceStealPolicy::FARTHEST: {
+            score = nearestListener(getVoicePosition(voiceData));
+            break;
+        }
+        case VoiceStealPolicy::LOWEST_PRIORITY:
+            if (voiceData.priority < newPriority) // more important than the new voice, never steal it
+                continue;
+            score = float(voiceData.priority);
+            break;
+        default: // OLDEST only uses the tie break
+            break;
+        }
+        if (!victim.isValid() || score > victimScore || (score == victimScore && voiceData.startOrder < victimStartOrder)) {
+            victim = voices.handleAt(i);
+            victimScore = score;
+            victimStartOrder = voiceData.startOrder;
+        }
+    }
+    return victim;
+}
+
+AudioEngine::VoiceCategory& AudioEngine::getVoiceCategory(int category) {
+    if (category >= int(voiceCategories.size()))
+        voiceCategories.resize(category + 1);
+    return voiceCategories[category];
+}
+
+void AudioEngine::flushEmitters() {
+    for (uint32_t emitter = 0; emitter < emitters.size(); emitter++) {
+        if (!emitters.isDirty(emitter))
+            continue;
+        const VoiceData* voiceData = voices.get(emitters.getVoice(emitter));
+        if (!voiceData->channel) // still loading, startVoice() sends the position
+            continue;
+        set3dChannelPosition(emitters.getPosition(emitter), emitters.getVelocity(emitter), voiceData->channel);
+        emitters.clearDirty(emitter);
+    }
+}
+
+void AudioEngine::updateEmitters() {
+    emitterRegistry.computeInRange(listenerPositions, numListeners);
+    const uint8_t* inRange = emitterRegistry.inRangeFlags();
+    for (size_t i = 0; i < emitterRegistry.size(); i++) {
+        bool isActive = emitterRegistry.isActive(i);
+        if (inRange[i] == uint8_t(isActive) && !(isActive && loopingVoiceLost(emitterRegistry[i])))
+            continue;
+        EmitterRegistry::Emitter& emitter = emitterRegistry[i];
+        if (inRange[i]) {
+            // one-shots aren't restarted until the emitter leaves and re-enters range
+            emitter.voice = playSound(emitter.sound, emitter.volume, emitter.reverbAmount, emitterRegistry.getPosition(i)).valueOr(VoiceHandle());
+            emitterRegistry.setActive(i, emitter.voice.isValid());
+        }
+        else {
+            if (voices.contains(emitter.voice))
+                stopSound(emitter.voice);
+            emitter.voice = VoiceHandle();
+            emitterRegistry.setActive(i, false);
+        }
+    }
 }
 
+bool AudioEngine::loopingVoiceLost(const EmitterRegistry::Emitter& emitter) {
+    if (voices.contains(emitter.voice))
+        return false;
+    const SoundData* soundData = sounds.get(emitter.sound);
+    if (!soundData || !soundData->isLoop)
+        return false;
+    // wait for a free voice rather than stealing one back, or emitters over the limit would take turns every frame
+    if (soundData->maxInstances > 0 && soundData->activeVoices >= soundData->maxInstances)
+        return false;
+    const VoiceCategory& voiceCategory = getVoiceCategory(soundData->category);
+    return voiceCategory.maxInstances <= 0 || voiceCategory.activeVoices < voiceCategory.maxInstances;
+}
+
+void AudioEngine::processEndedVoices() {
+    EndedVoice endedVoice;
+    while (endedVoices.pop(endedVoice)) {
+        VoiceHandle voice = voices.handleForIndex(endedVoice.voiceIndex);
+        VoiceData* voiceData = voices.get(voice);
+        // the slot may have been stopped and reused since the callback fired, only remove the voice that ended
+        if (voiceData && voiceData->channel == endedVoice.channel)
+            removeVoice(voice);
+    }
+}
+
+FMOD_RESULT F_CALL AudioEngine::channelCallback(FMOD_CHANNELCONTROL* channelControl, FMOD_CHANNELCONTROL_TYPE controlType,
+                                                FMOD_CHANNELCONTROL_CALLBACK_TYPE callbackType, void* /*commandData1*/, void* /*commandData2*/) {
+    if (controlType != FMOD_CHANNELCONTROL_CHANNEL || callbackType != FMOD_CHANNELCONTROL_CALLBACK_END || !callbackEngine)
+        return FMOD_OK;
+    FMOD::Channel* channel = reinterpret_cast<FMOD::Channel*>(channelControl);
+    void* userData = nullptr;
+    channel->getUserData(&userData);
+    EndedVoice endedVoice;
+    endedVoice.voiceIndex = uint32_t(reinterpret_cast<uintptr_t>(userData));
+    endedVoice.channel = channel;
+    // if the queue is full the voice stays in the table until it's stopped, which is harmless
+    callbackEngine->endedVoices.push(endedVoice);
+    AUDIO_TRACE_INSTANT("Channel ended");
+    return FMOD_OK;
+}
+
+void AudioEngine::processCommands() {
+    // only drain what was queued before this call, so producers can't keep update() busy indefinitely
+    size_t count = commands.sizeApprox();
+    commandQueueHighWater = std::max(commandQueueHighWater, count);
+    Command command;
+    for (size_t i = 0; i < count && commands.pop(command); i++) {
+        switch (command.type) {
+        case Command::PLAY_SOUND:
+            playSound(command.sound, command.value, command.reverbAmount, command.position);
+            break;
+        case Command::STOP_SOUND:
+            stopSound(command.voice);
+            break;
+        case Command::SET_VOLUME:
+            updateSoundLoopVolume(command.voice, command.value, command.fadeSampleLength);
+            break;
+        case Command::SET_3D_POSITION:
+            update3DSoundPosition(command.voice, command.position);
+            break;
+        case Command::PLAY_EVENT:
+            playEvent(command.event);
+            break;
+        case Command::STOP_EVENT:
+            stopEvent(command.event);
+            break;
+        case Command::SET_EVENT_PARAM:
+            setFMODEventParamValue(command.event, command.parameterName, command.value);
+            break;
+        }
+    }
+}
+
+void AudioEngine::set3dChannelPosition(Vec3 position, Vec3 velocity, FMOD::Channel* channel) {
+    FMOD_VECTOR fmodPosition = { position.x * DISTANCEFACTOR, position.y * DISTANCEFACTOR, position.z * DISTANCEFACTOR };
+    FMOD_VECTOR fmodVelocity = { velocity.x * DISTANCEFACTOR, velocity.y * DISTANCEFACTOR, velocity.z * DISTANCEFACTOR };
+    ERRCHECK(channel->set3DAttributes(&fmodPosition, &fmodVelocity));
+}
+
+void AudioEngine::updateOcclusion() {
+    occlusion.publishMeshes();
+    bool hasMeshes = occlusion.hasMeshes();
+    OcclusionSystem::Result result;
+    while (occlusion.popResult(result)) {
+        VoiceData* voiceData = voices.get(VoiceHandle::fromBits(result.voice));
+        if (!voiceData)
+            continue; // the voice ended while its ray was in flight
+        voiceData->occlusionPending = false;
+        if (hasMeshes)
+            ERRCHECK(voiceData->channel->set3DOcclusion(result.direct, result.reverb));
+    }
+    if (!hasMeshes)
+        return;
+
+    // rank voices by audibility scaled by how long they've waited, the small base keeps fully occluded
+    // (and so inaudible) voices refreshing, otherwise they'd never notice the occluder moving out of the way
+    occlusionCandidates.clear();
+    for (uint32_t i = 0; i < voices.size(); i++) {
+        VoiceData& voiceData = voices[i];
+        if (!voiceData.channel || voiceData.emitter == EmitterStore::NO_EMITTER || voiceData.occlusionPending)
+            continue;
+        voiceData.occlusionAge++;
+        float audibility = 0.0f;
+        voiceData.channel->getAudibility(&audibility);
+        occlusionCandidates.push_back(std::make_pair((0.05f + audibility) * float(voiceData.occlusionAge), i));
+    }
+    size_t rayCount = std::min(occlusionCandidates.size(), size_t(std::max(occlusionRaysPerUpdate, 0)));
+    std::nth_element(occlusionCandidates.begin(), occlusionCandidates.begin() + rayCount, occlusionCandidates.end(),
+                     [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
+
+    OcclusionSystem::Request request;
+    for (size_t i = 0; i < rayCount; i++) {
+        VoiceData& voiceData = voices[occlusionCandidates[i].second];
+        request.voice = voices.handleAt(occlusionCandidates[i].second).toBits();
+        request.emitter = emitters.getPosition(voiceData.emitter);
+        // FMOD spatializes each voice relative to its nearest listener, so that's the one the voice is occluded from
+        nearestListener(request.emitter, &request.listener);
+        if (!occlusion.request(request))
+            break;
+        voiceData.occlusionPending = true;
+        voiceData.occlusionAge = 0;
+    }
+}
+
+void AudioEngine::addDefaultReverbZone() {
+    FMOD_REVERB_PROPERTIES concertHall = FMOD_PRESET_CONCERTHALL;
+    defaultReverbZone = reverbZones.add(concertHall, Vec3(), 10.0f, 50.0f);
+}
+
+void AudioEngine::updateListeners(float deltaSeconds) {
+    for (int i = 0; i < numListeners; i++) {
+        Listener& listener = listeners[i];
+        if (deltaSeconds > 0.0f) {
+            FMOD_VECTOR velocity = {
+                (listener.position.x - listener.previousPosition.x) / deltaSeconds,
+                (listener.position.y - listener.previousPosition.y) / deltaSeconds,
+                (listener.position.z - listener.previousPosition.z) / deltaSeconds
+            };
+            if (velocity.x != listener.velocity.x || velocity.y != listener.velocity.y || velocity.z != listener.velocity.z)
+                listener.dirty = true;
+            listener.velocity = velocity;
+            listener.previousPosition = listener.position;
+        }
+        if (!listener.dirty)
+            continue;
+        // Studio passes its listeners on to the low level system, which spatializes plain channels with them too
+        FMOD_3D_ATTRIBUTES attributes = { listener.position, listener.velocity, listener.forward, listener.up };
+        ERRCHECK(studioSystem->setListenerAttributes(i, &attributes));
+        listener.dirty = false;
+    }
+}
+
+float AudioEngine::nearestListener(Vec3 position, Vec3* listenerPosition) const {
+    float nearestDistanceSq = -1.0f;
+    for (int i = 0; i < numListeners; i++) {
+        float dx = position.x - listenerPositions[i].x;
+        float dy = position.y - listenerPositions[i].y;
+        float dz = position.z - listenerPositions[i].z;
+        float distanceSq = dx * dx + dy * dy + dz * dz;
+        if (nearestDistanceSq < 0.0f || distanceSq < nearestDistanceSq) {
+            nearestDistanceSq = distanceSq;
+            if (listenerPosition)
+                *listenerPosition = listenerPositions[i];
+        }
+    }
+    return nearestDistanceSq;
+}
+
+// Debugging function definitions
+
 void AudioEngine::printEventInfo(FMOD::Studio::EventDescription* eventDescription) {
 
     int params;
@@ -242,9 +2222,6 @@ void AudioEngine::printEventInfo(FMOD::Studio::EventDescription* eventDescriptio
     ERRCHECK(eventDescription->is3D(&is3D));
     ERRCHECK(eventDescription->isOneshot(&isOneshot));
 
-    std::cout << "FMOD EventDescription has " << params << " parameter descriptions, "
-        << (is3D ? " is " : " isn't ") << " 3D, "
-        << (isOneshot ? " is " : " isn't ") << " oneshot, "
-        << (eventDescription->isValid() ? " is " : " isn't ") << " valid."
-        << '\n';
+    AUDIO_LOG_INFO("FMOD EventDescription has %d parameter descriptions, %s 3D, %s oneshot, %s valid.", params,
+        is3D ? "is" : "isn't", isOneshot ? "is" : "isn't", eventDescription->isValid() ? "is" : "isn't");
 }
\ No newline at end of file
@@ -12,24 +12,142 @@
 /// 
 #include <FMOD/fmod_studio.hpp>
 #include <FMOD/fmod.hpp>
-#include <iostream>
 #include <string>
 #include <vector>
 #include <list>
 #include <map>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <atomic>
 #include "SoundInfo.h"
+#include "AudioTypes.h"
+#include "MPSCQueue.h"
+#include "EmitterStore.h"
+#include "EmitterRegistry.h"
+#include "ReverbZoneManager.h"
+#include "OcclusionSystem.h"
+#include "PackFile.h"
+#include "AudioManifest.h"
+#include "Logger.h"
+#include "AudioErrors.h"
+#include "AudioStats.h"
+#include "AudioTrace.h"
+#include "AudioAllocator.h"
 
 /**
- * Error Handling Function for FMOD Errors
- * @param result - the FMOD_RESULT generated during every FMOD 
+ * Load state of a sound, bank or event sample data, see AudioEngine::loadSoundAsync(),
+ * AudioEngine::loadFMODStudioBankAsync() and AudioEngine::preloadEventSampleData()
  */
-void ERRCHECK_fn(FMOD_RESULT result, const char* file, int line);
-#define ERRCHECK(_result) ERRCHECK_fn(_result, __FILE__, __LINE__)
+enum class SoundLoadState {
+    LOADING,
+    READY,
+    FAILED
+};
+
+/**
+ * How a sound's audio data is held in memory
+ */
+enum class SoundLoadPolicy {
+    // Choose based on the file's size, see AudioEngine::setLoadPolicyThresholds()
+    AUTO,
+    // Fully decoded to PCM at load time. Cheapest to play, most memory. Best for short, frequent sounds
+    DECOMPRESSED,
+    // Kept compressed in memory and decoded on playback (FMOD_CREATECOMPRESSEDSAMPLE)
+    COMPRESSED,
+    // Streamed from disk during playback (System::createStream). Near-instant to load and uses
+    // little memory, but each streamed sound can only play on one voice at a time, so its voice limit
+    // is 1 with VoiceStealPolicy::OLDEST: playing it again restarts it. Best for music
+    STREAM
+};
+
+/**
+ * How a voice is chosen to be stopped when a voice limit is reached
+ */
+enum class VoiceStealPolicy {
+    // Don't steal, the new voice isn't played
+    NONE,
+    // Stop the voice which started first
+    OLDEST,
+    // Stop the voice with the lowest audibility (volume after distance attenuation, occlusion etc)
+    QUIETEST,
+    // Stop the voice furthest from the listener
+    FARTHEST,
+    // Stop the voice with the lowest priority, unless it's more important than the new voice
+    LOWEST_PRIORITY
+};
+
+/**
+ * Settings passed to AudioEngine::init()
+ */
+struct AudioEngineSettings {
+    // Total voices FMOD tracks, including virtual voices which aren't mixed
+    int maxVoices = 1024;
+    // Voices which are actually mixed. The least audible voices beyond this become virtual
+    int maxRealVoices = 64;
+    // Voices quieter than this become virtual and stop costing mixer CPU (FMOD_INIT_VOL0_BECOMES_VIRTUAL)
+    float virtualVoiceVolume = 0.001f;
+    // Reverb zones which may be backed by a real FMOD::Reverb3D at once, the nearest to the listener win
+    int maxActiveReverbZones = 4;
+    // Occlusion rays cast per update(), spread over the 3D voices by audibility and time since their last ray
+    int occlusionRaysPerUpdate = 64;
+    // Frames of history in the rolling windows of getStats()
+    int statsWindowFrames = 300;
+    // Size of the fixed memory slice FMOD allocates from through AudioAllocator, 0 leaves FMOD on the CRT heap.
+    // FMOD's allocator can't change once a system exists, so only the first init() in a process applies it
+    size_t memoryPoolBytes = 0;
+};
+
+/**
+ * Where FMOD reads a bank's data from
+ */
+enum class BankMemorySource {
+    // Loaded by FMOD into memory it allocated, from a file or copied out of a pack
+    HEAP,
+    // Read in place from a mapping of the bank file the engine holds
+    OWN_MAPPING,
+    // Read in place from the mapping of the pack file the bank is in
+    PACK_MAPPING
+};
+
+/**
+ * Memory held for a bank, see getBankMemoryUsage()
+ */
+struct BankMemoryUsage {
+    // size of the bank file. Mapped banks share these pages with the OS file cache rather than copying them
+    unsigned long long fileBytes = 0;
+    BankMemorySource source = BankMemorySource::HEAP;
+    // true unless source is HEAP
+    bool mapped = false;
+    // events loaded from the bank through the audio engine, and their instances
+    int eventCount = 0;
+    int instanceCount = 0;
+    // memory used by those instances, as reported by EventInstance::getMemoryUsage()
+    unsigned long long instanceBytes = 0;
+    unsigned long long sampleDataBytes = 0;
+};
+
+// Called from AudioEngine::update() once an asynchronously loaded sound has finished opening
+using SoundLoadedCallback = std::function<void(SoundHandle sound, bool success)>;
+
+// Called from AudioEngine::update() once an asynchronously loaded bank has finished loading
+using BankLoadedCallback = std::function<void(const std::string& filePath, bool success)>;
+
+// Called from AudioEngine::update() once an event's sample data has finished loading
+using EventLoadedCallback = std::function<void(EventHandle event, bool success)>;
+
+// Called from AudioEngine::update() once every bank and event sample data in a manifest has loaded
+using ManifestLoadedCallback = std::function<void(bool success)>;
 
 /**
  * Class that handles the process of loading and playing sounds by wrapping FMOD's functionality.
  * Deals with all FMOD calls so that FMOD-specific code does not need to be used outside this class.
  * Only one AudioEngine should be constructed for an application.
+ *
+ * Apart from the queue*() methods, AudioEngine methods must be called from the thread which owns the
+ * audio engine (the one calling update()). Other threads, e.g. gameplay jobs, issue sounds through the
+ * queue*() methods, which push commands onto a lock-free queue that update() drains in one batch.
  */
 class AudioEngine {
 public:
@@ -42,25 +160,238 @@ public:
     /**
      * Initializes Audio Engine Studio and Core systems to default values. 
      */
-    void init();
+    void init(const AudioEngineSettings& settings = AudioEngineSettings());
 
     /**
      * Method that is called to deactivate the audio engine after use.
+     * Releases every sound, voice, event and bank the audio engine holds.
      */
     void deactivate();
 
     /**
-    * Method which should be called every frame of the game loop
+    * Method which should be called every frame of the game loop.
+    * Measures the time since the previous update to derive emitter and listener velocities.
     */
     void update();
+
+    /**
+     * Version of update() for fixed time step loops, using the caller's frame time to derive velocities
+     */
+    void update(float deltaSeconds);
     
     /**
      * Loads a sound from disk using provided settings
      * Prepares for later playback with playSound()
      * Only reads the audio file and loads into the audio engine
      * if the sound file has already been added to the cache
+     * @param policy - whether the sound is decompressed, kept compressed or streamed
+     * @return handle used to play the sound back, or the FMOD error if the sound couldn't be created.
+     * If the sound was already loaded, the existing handle is returned. If it is still loading
+     * asynchronously, this blocks until the load finishes, returning its error if it failed
+     */
+    AudioResult<SoundHandle> loadSound(SoundInfo soundInfo, SoundLoadPolicy policy = SoundLoadPolicy::AUTO);
+
+    /**
+     * Looks up the handle of a sound that has already been loaded with loadSound().
+     * This is a string lookup, so it should be done once at load time and the handle kept.
+     * @return the sound's handle, or an invalid handle if the sound isn't loaded
+     */
+    SoundHandle getSoundHandle(SoundInfo soundInfo);
+
+    /**
+     * Starts loading a sound in the background using FMOD's non-blocking loader and returns immediately.
+     * The handle can be played straight away: plays issued while the sound is loading are queued and start
+     * automatically once loading completes. Loading progress is polled during update().
+     * @param onLoaded - optional callback, called from update() when loading succeeds or fails
+     * @param policy - whether the sound is decompressed, kept compressed or streamed
+     * @return handle to the sound, which acts as the completion future (see getSoundLoadState())
+     */
+    SoundHandle loadSoundAsync(SoundInfo soundInfo, SoundLoadedCallback onLoaded = nullptr,
+                               SoundLoadPolicy policy = SoundLoadPolicy::AUTO);
+
+    /**
+     * Starts loading a batch of sounds asynchronously. All files are submitted up front so FMOD's
+     * loader can work through them back to back while the caller carries on.
+     * @return one handle per SoundInfo, in the same order
+     */
+    std::vector<SoundHandle> loadSounds(const std::vector<SoundInfo>& soundInfos, SoundLoadedCallback onLoaded = nullptr,
+                                        SoundLoadPolicy policy = SoundLoadPolicy::AUTO);
+
+    /**
+     * Sets the file sizes SoundLoadPolicy::AUTO uses to pick a policy. Files smaller than compressedBytes are
+     * decompressed, files smaller than streamBytes are kept compressed, and anything larger is streamed.
+     */
+    void setLoadPolicyThresholds(unsigned long long compressedBytes, unsigned long long streamBytes);
+
+    /**
+     * Returns whether a sound is still loading, ready to play, or failed to load.
+     * Handles to sounds which failed to load are released, so stale handles report FAILED.
+     */
+    SoundLoadState getSoundLoadState(SoundHandle sound);
+
+    /**
+     * Mounts a pack file (see PackFile.h). Sounds and banks whose paths match an entry in a mounted pack are
+     * read from the pack's memory mapping instead of the OS file system. Later mounts take precedence.
+     * @return false if the pack couldn't be opened
+     */
+    bool mountPackFile(const char* filePath);
+
+    /**
+     * Unmounts a pack file. Sounds and banks loaded from it must be unloaded first.
+     */
+    void unmountPackFile(const char* filePath);
+
+    /**
+     * Drops a reference to a sound. loadSound(), loadSoundAsync() and retainSound() each add a reference.
+     * Once a sound has no references and no voices playing it, it stays cached so a later load is free,
+     * but becomes eligible for eviction when the sound memory budget is exceeded.
+     */
+    void unloadSound(SoundHandle sound);
+
+    /**
+     * Adds a reference to a loaded sound, preventing it from being evicted
+     */
+    void retainSound(SoundHandle sound);
+
+    /**
+     * Sets the maximum memory that cached sounds may use. When exceeded, update() evicts the least
+     * recently played sounds which have no references and no voices. 0 means unlimited (the default).
+     * Referenced sounds are never evicted, so the budget can still be exceeded if they don't fit.
+     */
+    void setSoundMemoryBudget(unsigned long long budgetBytes);
+
+    /**
+     * Immediately evicts every cached sound which has no references and no voices
+     */
+    void purgeUnusedSounds();
+
+    /**
+     * Returns the estimated memory used by cached sounds, in bytes
+     * (computed from each sound's format and length when it finishes loading)
+     */
+    unsigned long long getSoundMemoryUsage();
+
+    /**
+     * Returns the total memory currently allocated by FMOD, in bytes (FMOD::Memory_GetStats)
+     */
+    int getFMODMemoryUsage();
+
+    /**
+     * Snapshot of the engine's CPU, voice, file, command buffer and memory counters. Per-frame values are
+     * summarized over the last AudioEngineSettings::statsWindowFrames updates.
+     */
+    AudioStats getStats();
+
+    /**
+     * Usage of the memory slice set by AudioEngineSettings::memoryPoolBytes, per FMOD memory category.
+     * Empty if FMOD allocates from the CRT heap
+     */
+    AudioMemoryStats getMemoryPoolStats();
+
+    /**
+     * Clears the rolling windows and high-water marks reported by getStats()
+     */
+    void resetStats();
+
+    /**
+     * Sets the distances over which a 3D sound attenuates. Beyond the max distance the sound is inaudible,
+     * and ambient emitters playing it are culled. Defaults are 0.5 and 5000.
+     */
+    void setSound3DMinMaxDistance(SoundHandle sound, float minDistance, float maxDistance);
+
+    /**
+     * Adds a persistent ambient emitter which plays a (usually looping) 3D sound at a fixed or slowly moving
+     * position. Every update() the emitters' distances to the listener are computed with SIMD, and only
+     * emitters within their sound's max distance hold a voice; the rest release theirs. This keeps the
+     * channel count proportional to nearby emitters however many are placed in the level.
+     * The emitter holds a reference to the sound until it's removed.
+     * @param reverbAmount wet level sent to the reverb zones, as for playSound()
+     */
+    EmitterHandle addEmitter(SoundHandle sound, Vec3 position, float volume = 1.0f, float reverbAmount = 0.0f);
+
+    /**
+     * Removes an ambient emitter, stopping its voice
+     */
+    void removeEmitter(EmitterHandle emitter);
+
+    /**
+     * Moves an ambient emitter
+     */
+    void setEmitterPosition(EmitterHandle emitter, Vec3 position);
+
+    /**
+     * Checks if an ambient emitter is within range of the listener and holding a voice
+     */
+    bool emitterIsActive(EmitterHandle emitter);
+
+    /**
+     * Finds the ambient emitters within radius of a position, e.g. for gameplay queries or debug drawing.
+     * Uses a spatial hash grid, so the cost depends on the emitters near the position rather than the total.
+     * @param results the handles found are appended to it
+     */
+    void getEmittersInRadius(Vec3 center, float radius, std::vector<EmitterHandle>& results);
+
+    /**
+     * Adds a reverb zone, an acoustic space whose reverb is heard fully within minDistance of its position
+     * and fades out towards maxDistance. Any number of zones can be added; only the
+     * AudioEngineSettings::maxActiveReverbZones nearest zones containing the listener are mixed.
+     * Until the first zone is added the engine provides a default concert hall zone at the origin, heard
+     * within 10 and fading out by 50 units; it's removed when a zone is added and restored once every
+     * zone has been removed.
+     * @param properties a preset, e.g. FMOD_REVERB_PROPERTIES cave = FMOD_PRESET_CAVE, or custom properties
+     */
+    ReverbZoneHandle addReverbZone(const FMOD_REVERB_PROPERTIES& properties, Vec3 position, float minDistance, float maxDistance);
+
+    /**
+     * Removes a reverb zone
+     */
+    void removeReverbZone(ReverbZoneHandle zone);
+
+    /**
+     * Moves a reverb zone
+     */
+    void setReverbZonePosition(ReverbZoneHandle zone, Vec3 position);
+
+    /**
+     * Changes the reverb properties of a zone
+     */
+    void setReverbZoneProperties(ReverbZoneHandle zone, const FMOD_REVERB_PROPERTIES& properties);
+
+    /**
+     * Changes the distances a reverb zone is heard fully within and fades out at
+     */
+    void setReverbZoneDistances(ReverbZoneHandle zone, float minDistance, float maxDistance);
+
+    /**
+     * Changes how many reverb zones may be mixed at once
+     */
+    void setMaxActiveReverbZones(int maxActive);
+
+    /**
+     * Checks if a reverb zone is near enough to the listener to be mixed
+     */
+    bool reverbZoneIsActive(ReverbZoneHandle zone);
+
+    /**
+     * Adds level geometry which occludes 3D voices, e.g. walls or a building's shell. Occlusion is computed
+     * on a worker thread by casting rays through a BVH of every mesh, from the listener to each voice, and
+     * applied with FMOD::Channel::set3DOcclusion() a few updates later.
+     * @param indices three vertex indices per triangle
+     * @param directOcclusion 0 to 1, how much crossing one of the mesh's triangles muffles the direct path
+     * @param reverbOcclusion 0 to 1, the same for the reverb path
+     */
+    OcclusionMeshHandle addOcclusionMesh(const Vec3* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                                         float directOcclusion = 1.0f, float reverbOcclusion = 1.0f);
+
+    /**
+     * Removes occluding geometry
+     */
+    void removeOcclusionMesh(OcclusionMeshHandle mesh);
+
+    /**
+     * Changes how many occlusion rays are cast per update(), see AudioEngineSettings::occlusionRaysPerUpdate
      */
-    void loadSound(SoundInfo soundInfo);
+    void setOcclusionRaysPerUpdate(int rays);
 
     /**
     * Plays a sound file using FMOD's low level audio system. If the sound file has not been
@@ -70,12 +401,29 @@ public:
     *                 or any other FMOD-supported audio format)
     */
     void playSound(SoundInfo soundInfo);
+
+    /**
+     * Plays a loaded sound. 3D sounds are placed at the provided position. If the sound is still loading,
+     * playback is queued and starts once loading completes.
+     * @param reverbAmount wet level sent to the reverb zones around the listener, from 0 to 1. With no zones
+     *        added this is the default concert hall zone, see addReverbZone()
+     * @return handle to the voice, so it can be stopped or updated later. The handle goes stale once the
+     *         voice is stopped or a one-shot finishes playing. FMOD_ERR_INVALID_HANDLE if the sound handle is
+     *         stale, FMOD_ERR_CHANNEL_ALLOC if a voice limit refused the voice, or the FMOD error playing it.
+     */
+    AudioResult<VoiceHandle> playSound(SoundHandle sound, float volume = 1.0f, float reverbAmount = 0.0f, Vec3 position = Vec3());
     
     /**
      * Stops a looping sound if it's currently playing.
      */
     void stopSound(SoundInfo soundInfo);
 
+    /**
+     * Stops a voice if it's currently playing.
+     * @return FMOD_OK, FMOD_ERR_INVALID_HANDLE if the voice already ended, or the FMOD error stopping it
+     */
+    FMOD_RESULT stopSound(VoiceHandle voice);
+
     /**
      * Method that updates the volume of a soundloop that is playing. This can be used to create audio 'fades'
      * where the volume ramps up or down to the provided new volume
@@ -84,7 +432,14 @@ public:
      */
     void updateSoundLoopVolume(SoundInfo &soundInfo, float newVolume, unsigned int fadeSampleLength = 0);
 
-   
+    /**
+     * Updates the volume of a playing voice, optionally fading from its current volume.
+     * @param fadeSampleLength the length in samples of the fade. If less than 64 samples, the default
+     *                         FMOD fade out is used
+     * @return FMOD_OK, FMOD_ERR_INVALID_HANDLE if the voice already ended, or the first FMOD error applying the volume
+     */
+    FMOD_RESULT updateSoundLoopVolume(VoiceHandle voice, float newVolume, unsigned int fadeSampleLength = 0);
+
 
     /**
     * Updates the position of a looping 3D sound that has already been loaded and is playing back.
@@ -92,15 +447,66 @@ public:
     * SoundInfo::set3DCoords(x,y,z) should be called before this method to set the new desired location.
     */
     void update3DSoundPosition(SoundInfo soundInfo); 
+
+    /**
+     * Updates the position of a playing 3D voice. The new position is sent to FMOD during the next update().
+     * @return FMOD_OK, or FMOD_ERR_INVALID_HANDLE if the voice already ended or isn't 3D
+     */
+    FMOD_RESULT update3DSoundPosition(VoiceHandle voice, Vec3 position);
+
+    /**
+     * Updates the positions of many 3D voices at once. Positions are stored and only the voices that
+     * moved are sent to FMOD, once per update().
+     * @param voiceHandles, positions - arrays of count elements, positions[i] is the new position of voiceHandles[i]
+     */
+    void set3DPositions(const VoiceHandle* voiceHandles, const Vec3* positions, size_t count);
+    void set3DPositions(const std::vector<VoiceHandle>& voiceHandles, const std::vector<Vec3>& positions);
       
     /**
      * Checks if a looping sound is playing.
      */
     bool soundIsPlaying(SoundInfo soundInfo); 
+
+    /**
+     * Checks if a voice is still playing, or waiting for its sound to load.
+     */
+    bool soundIsPlaying(VoiceHandle voice);
+
+    /**
+     * Checks if a voice has been virtualized by FMOD, i.e. it's tracked but not mixed because it's
+     * inaudible or lost out to more important voices.
+     */
+    bool soundIsVirtual(VoiceHandle voice);
+
+    /**
+     * Limits how many voices of a sound can play at once. When the limit is reached, a new voice
+     * steals one of the sound's voices according to the policy, or isn't played.
+     * @param maxInstances - 0 for unlimited. Streamed sounds are always limited to 1
+     */
+    void setSoundVoiceLimit(SoundHandle sound, int maxInstances, VoiceStealPolicy policy = VoiceStealPolicy::OLDEST);
+
+    /**
+     * Sets the priority of a sound's future voices, from 0 (most important) to 256 (least important).
+     * FMOD virtualizes low priority voices first when it runs out of real voices. Default is 128.
+     */
+    void setSoundPriority(SoundHandle sound, int priority);
+
+    /**
+     * Assigns a sound to a voice category (e.g. weapons, footsteps), so voice limits can be shared
+     * across many sounds. All sounds start in category 0.
+     */
+    void setSoundCategory(SoundHandle sound, int category);
+
+    /**
+     * Limits how many voices of all sounds in a category can play at once
+     * @param maxInstances - 0 for unlimited
+     */
+    void setCategoryVoiceLimit(int category, int maxInstances, VoiceStealPolicy policy = VoiceStealPolicy::OLDEST);
    
 
     /**
-     * Sets the position of the listener in the 3D scene.
+     * Sets the position of the listener in the 3D scene. The listener's velocity is derived from its
+     * movement between updates, and the new attributes are sent to FMOD during the next update().
      * @param posX, posY, posZ - 3D translation of listener
      * @param forwardX, forwardY, forwardZ - forward angle character is looking in
      * @param upX, upY, upZ - up which must be perpendicular to forward vector
@@ -109,52 +515,250 @@ public:
                                float forwardX, float forwardY, float forwardZ,
                                float upX,      float upY,      float upZ);
 
+    /**
+     * Sets the position of one of several listeners, see set3DNumListeners()
+     * @param listener - index of the listener, from 0 to get3DNumListeners() - 1
+     */
+    void set3DListenerPosition(int listener,
+                               float posX,     float posY,     float posZ,
+                               float forwardX, float forwardY, float forwardZ,
+                               float upX,      float upY,      float upZ);
+
+    /**
+     * Sets how many listeners there are, e.g. one per player in split-screen (up to FMOD_MAX_LISTENERS).
+     * Each voice is spatialized by FMOD relative to its nearest listener, and emitter culling, reverb zones,
+     * voice stealing and occlusion all use the listener nearest to each emitter.
+     */
+    void set3DNumListeners(int count);
+
+    int get3DNumListeners() const { return numListeners; }
+
+    /**
+     * Sets how much a listener contributes to events' spatialization, 0 to 1, e.g. to fade a player
+     * in or out of split-screen. Only affects FMOD Studio events.
+     */
+    void set3DListenerWeight(int listener, float weight);
+
     /**
     * Utility method that returns the length of a SoundInfo's audio file in milliseconds
     * If the sound hasn't been loaded, returns 0
     */
     unsigned int getSoundLengthInMS(SoundInfo soundInfo);
 
+    /**
+     * Utility method that returns the length of a loaded sound in milliseconds
+     * If the handle is stale, returns 0
+     */
+    unsigned int getSoundLengthInMS(SoundHandle sound);
+
     /**
      * Loads an FMOD Studio soundbank 
      * TODO Fix
+     * @return FMOD_OK, or the FMOD error the bank failed to load with
      */
-    void loadFMODStudioBank(const char* filePath);
+    FMOD_RESULT loadFMODStudioBank(const char* filePath);
+
+    /**
+     * Starts loading an FMOD Studio soundbank without blocking (FMOD_STUDIO_LOAD_BANK_NONBLOCKING).
+     * Its events can be loaded once getBankLoadState() reports READY or onLoaded is called.
+     * @param preloadSampleData - also load the sample data of every event in the bank before reporting it loaded
+     */
+    void loadFMODStudioBankAsync(const char* filePath, BankLoadedCallback onLoaded = nullptr, bool preloadSampleData = false);
+
+    /**
+     * Loads an FMOD Studio soundbank asynchronously straight from a memory mapping of the file, with
+     * FMOD_STUDIO_LOAD_MEMORY_POINT, so FMOD reads the bank in place instead of copying it into its own
+     * buffers and the OS can share the bank's pages between processes. Banks inside a mounted pack file
+     * are read from the pack's mapping. The mapping is kept until the bank is unloaded.
+     */
+    void loadFMODStudioBankMapped(const char* filePath, BankLoadedCallback onLoaded = nullptr, bool preloadSampleData = false);
+
+    /**
+     * Unloads an FMOD Studio soundbank once it has been unloaded as many times as it was loaded.
+     * Events loaded through the audio engine which only this bank provides are released first, stopping
+     * the instances the engine created for them, so the memory of the bank and its events is reclaimed
+     * by the next update(). Events another loaded bank also provides stay loaded, and instances created
+     * outside the audio engine are left to FMOD's own bank unloading.
+     * @return FMOD_OK, FMOD_ERR_INVALID_PARAM if the bank isn't loaded, or the FMOD error unloading it
+     */
+    FMOD_RESULT unloadFMODStudioBank(const char* filePath);
+
+    /**
+     * Reports the memory held for a loaded bank. FMOD has no per-bank memory query, so this adds up
+     * the bank's file size and the memory of the instances of its events
+     */
+    BankMemoryUsage getBankMemoryUsage(const char* filePath);
+
+    /**
+     * Gets the load state of a bank. Banks which were never loaded report FAILED
+     */
+    SoundLoadState getBankLoadState(const char* filePath);
+
+    /**
+     * Starts loading an event's sample data into memory, so its first start() doesn't wait on disk I/O.
+     * Otherwise FMOD loads sample data lazily when an instance first starts. Streaming assets are still
+     * streamed from disk.
+     */
+    void preloadEventSampleData(EventHandle event, EventLoadedCallback onLoaded = nullptr);
+
+    /**
+     * Loads a level's banks asynchronously, then loads its events and preloads their sample data
+     * @param onLoaded - called once everything has loaded, or failed to
+     */
+    void loadManifest(const AudioManifest& manifest, ManifestLoadedCallback onLoaded = nullptr);
+
+    /**
+     * Reads a manifest file (see AudioManifest.h) and loads it
+     * @return false if the file couldn't be read
+     */
+    bool loadManifest(const char* filePath, ManifestLoadedCallback onLoaded = nullptr);
+
+    /**
+     * Releases the events and banks loaded by the most recent loadManifest() of an equal manifest, so
+     * loading and unloading a level's manifest repeatedly doesn't accumulate references. A load still in
+     * progress is abandoned and its callback told it failed.
+     * @return false if no such manifest is loaded
+     */
+    bool unloadManifest(const AudioManifest& manifest);
     
     /**
      * Loads an FMOD Studio Event. The Soundbank that this event is in must have been loaded before
      * calling this method.
      * TODO Fix
+     * @param paramsValues - parameter values set on every instance of the event when it's created or recycled
+     * @param poolSize - instances created up front for playEventInstance(), see setEventPoolSize()
+     * @return handle used to control the event, or the FMOD error if the event isn't in a loaded bank or
+     * its instance couldn't be created. If the event was already loaded, the existing handle is returned
      */
-    void loadFMODStudioEvent(const char* eventName, std::vector<std::pair<const char*, float>> paramsValues = { });
+    AudioResult<EventHandle> loadFMODStudioEvent(const char* eventName, std::vector<std::pair<const char*, float>> paramsValues = { },
+                                                 int poolSize = 0);
+
+    /**
+     * Releases an event once it has been unloaded as many times as it was loaded with loadFMODStudioEvent(),
+     * stopping and releasing all its instances and unloading any sample data preloaded for it
+     */
+    void unloadFMODStudioEvent(EventHandle event);
+
+    /**
+     * Looks up the handle of an event that has already been loaded with loadFMODStudioEvent().
+     * This is a string lookup, so it should be done once at load time and the handle kept.
+     * @return the event's handle, or an invalid handle if the event isn't loaded
+     */
+    EventHandle getEventHandle(const char* eventName);
     
     /**
      * Sets the parameter of an FMOD Soundbank Event Instance.
+     * The name is looked up in the parameters cached when the event was loaded; prefer the
+     * EventParameterHandle overload for parameters set every frame.
      */
     void setFMODEventParamValue(const char* eventName, const char* parameterName, float value);
+    void setFMODEventParamValue(EventHandle event, const char* parameterName, float value);
+
+    /**
+     * Resolves an event parameter by name, once, to a handle for setFMODEventParamValue()
+     * and setEventInstanceParamValue()
+     * @return the parameter's handle, or an invalid handle if the event has no such parameter
+     */
+    EventParameterHandle getEventParameterHandle(EventHandle event, const char* parameterName);
+
+    /**
+     * Sets a parameter of an event's default instance. Values set during a frame are batched and sent to
+     * FMOD with one setParametersByIDs() call per instance in the next update()
+     */
+    void setFMODEventParamValue(EventParameterHandle parameter, float value);
     
     /**
-     * Plays the specified instance of an event
-     * TODO support playback of multiple event instances
+     * Plays the event's default instance, restarting it if it's already playing.
+     * Use playEventInstance() for events which overlap themselves, e.g. footsteps or gunfire.
      * TODO Fix playback
+     * @return FMOD_OK, FMOD_ERR_INVALID_HANDLE if the event isn't loaded, or the FMOD error starting it
      */
     void playEvent(const char* eventName, int instanceIndex = 0);
+    FMOD_RESULT playEvent(EventHandle event);
     
     /**
      * Stops the specified instance of an event, if it is playing.
+     * @return FMOD_OK, FMOD_ERR_INVALID_HANDLE if the event isn't loaded, or the FMOD error stopping it
      */
     void stopEvent(const char* eventName, int instanceIndex = 0);
+    FMOD_RESULT stopEvent(EventHandle event);
  
     /**
      * Sets the volume of an event.
      * @param volume0to1 - volume of the event, from 0 (min vol) to 1 (max vol)
+     * @return FMOD_OK, FMOD_ERR_INVALID_HANDLE if the event isn't loaded, or the FMOD error setting the volume
      */
     void setEventVolume(const char* eventName, float volume0to1 = .75f);
+    FMOD_RESULT setEventVolume(EventHandle event, float volume0to1 = .75f);
 
     /**
      * Checks if an event is playing.
      */
     bool eventIsPlaying(const char* eventName, int instance = 0);
+    bool eventIsPlaying(EventHandle event);
+
+    /**
+     * Ensures at least poolSize idle instances of an event exist, so the next poolSize calls to
+     * playEventInstance() don't create any. Instances return to the pool when they stop, so the pool
+     * grows to the most instances of the event ever playing at once.
+     */
+    void setEventPoolSize(EventHandle event, int poolSize);
+
+    /**
+     * Starts a new instance of an event taken from its pool, which plays alongside any other instances.
+     * The instance is recycled automatically once it stops, after which the handle is no longer valid.
+     * @param position - position of the instance, for 3D events
+     * @return handle of the instance, FMOD_ERR_INVALID_HANDLE if the event isn't loaded, or the FMOD error
+     *         creating or starting the instance
+     */
+    AudioResult<EventInstanceHandle> playEventInstance(EventHandle event);
+    AudioResult<EventInstanceHandle> playEventInstance(EventHandle event, Vec3 position);
+
+    /**
+     * Stops an instance started with playEventInstance()
+     * @param immediate - cut the instance off rather than letting it fade out
+     * @return FMOD_OK, FMOD_ERR_INVALID_HANDLE if the instance was already recycled, or the FMOD error stopping it
+     */
+    FMOD_RESULT stopEventInstance(EventInstanceHandle instance, bool immediate = false);
+
+    /**
+     * Sets a parameter of an instance. Like setFMODEventParamValue() the value is batched and sent in the
+     * next update(), so FMOD errors are only reported through the error callback, see AudioErrors.h
+     */
+    void setEventInstanceParamValue(EventInstanceHandle instance, const char* parameterName, float value);
+    void setEventInstanceParamValue(EventInstanceHandle instance, EventParameterHandle parameter, float value);
+
+    FMOD_RESULT setEventInstanceVolume(EventInstanceHandle instance, float volume0to1);
+
+    FMOD_RESULT set3DEventInstancePosition(EventInstanceHandle instance, Vec3 position);
+
+    /**
+     * Checks if an instance started with playEventInstance() is still playing
+     */
+    bool eventInstanceIsPlaying(EventInstanceHandle instance);
+
+    /**
+     * Thread safe versions of the playback methods above. The command is queued and executed on the
+     * audio engine's thread during the next update(). Handles must have been obtained beforehand,
+     * so a voice started with queuePlaySound() can't be addressed later, but is still cleaned up when it ends.
+     * @return false if the command queue is full and the command was dropped
+     */
+    bool queuePlaySound(SoundHandle sound, float volume = 1.0f, float reverbAmount = 0.0f, Vec3 position = Vec3());
+    bool queueStopSound(VoiceHandle voice);
+    bool queueSoundVolume(VoiceHandle voice, float newVolume, unsigned int fadeSampleLength = 0);
+    bool queue3DSoundPosition(VoiceHandle voice, Vec3 position);
+    bool queuePlayEvent(EventHandle event);
+    bool queueStopEvent(EventHandle event);
+
+    /**
+     * Thread safe version of setFMODEventParamValue().
+     * @param parameterName - copied into the command, must be shorter than MAX_QUEUED_PARAM_NAME characters
+     * @return false if the command queue is full, or parameterName is null or too long
+     */
+    bool queueEventParamValue(EventHandle event, const char* parameterName, float value);
+
+    // Longest event parameter name which can be passed to queueEventParamValue()
+    static const unsigned int MAX_QUEUED_PARAM_NAME = 48;
 
     /**
      * Mutes all sounds for the audio engine
@@ -176,20 +780,471 @@ public:
 
 private:  
 
+    /**
+     * A sound loaded into the audio engine
+     */
+    struct SoundData {
+        FMOD::Sound* sound = nullptr;
+        bool is3D = false;
+        bool isLoop = false;
+        SoundLoadPolicy policy = SoundLoadPolicy::DECOMPRESSED;
+        SoundLoadState loadState = SoundLoadState::LOADING;
+        // references added by loadSound(), loadSoundAsync() and retainSound()
+        int refCount = 0;
+        // tracked voices playing, or waiting to play, this sound
+        int activeVoices = 0;
+        // estimated memory used by the sound's data, known once it has loaded
+        unsigned long long memoryBytes = 0;
+        // position in soundLRU
+        std::list<SoundHandle>::iterator lruPosition;
+        // voice limiting, see setSoundVoiceLimit()
+        int maxInstances = 0;
+        VoiceStealPolicy stealPolicy = VoiceStealPolicy::OLDEST;
+        int priority = 128;
+        int category = 0;
+        // 3D attenuation distances in world units, see setSound3DMinMaxDistance()
+        float minDistance = 0.5f;
+        float maxDistance = 5000.0f;
+        // SoundInfo uniqueID the sound was loaded with, used to remove its lookup entry
+        std::string uniqueID;
+        // Voices played while the sound was loading, started once it's ready
+        std::vector<VoiceHandle> pendingVoices;
+        // Callbacks to call once an asynchronous load completes
+        std::vector<SoundLoadedCallback> onLoaded;
+    };
+
+    /**
+     * A sound playing back on an FMOD::Channel.
+     * The channel is null while the voice waits for its sound to finish loading,
+     * in which case volume and reverbAmount hold the settings it will start with.
+     */
+    struct VoiceData {
+        FMOD::Channel* channel = nullptr;
+        SoundHandle sound;
+        float volume = 1.0f;
+        float reverbAmount = 0.0f;
+        // index of the voice's 3D state in the emitter store, NO_EMITTER for 2D voices
+        uint32_t emitter = EmitterStore::NO_EMITTER;
+        // copied from the sound when the voice is created
+        int priority = 128;
+        int category = 0;
+        // increases with every voice played, for VoiceStealPolicy::OLDEST
+        unsigned long long startOrder = 0;
+        // updates since the voice's occlusion was last requested, raises its priority for the next ray
+        unsigned int occlusionAge = 0;
+        // set while an occlusion ray for the voice is queued or being cast
+        bool occlusionPending = false;
+    };
+
+    /**
+     * Voice limit shared by the sounds in a category
+     */
+    struct VoiceCategory {
+        int maxInstances = 0;
+        VoiceStealPolicy stealPolicy = VoiceStealPolicy::OLDEST;
+        int activeVoices = 0;
+    };
+
+    /**
+     * A listener's 3D attributes
+     */
+    struct Listener {
+        // Listener head position, initialized to default value
+        FMOD_VECTOR position = { 0.0f, 0.0f, -1.0f };
+        // Listener forward vector, initialized to default value
+        FMOD_VECTOR forward = { 0.0f, 0.0f, 1.0f };
+        // Listener upwards vector, initialized to default value
+        FMOD_VECTOR up = { 0.0f, 1.0f, 0.0f };
+        // Position at the previous update, for deriving the velocity
+        FMOD_VECTOR previousPosition = { 0.0f, 0.0f, -1.0f };
+        // Velocity in units per second
+        FMOD_VECTOR velocity = { 0.0f, 0.0f, 0.0f };
+        // Set when the attributes need sending to FMOD
+        bool dirty = true;
+    };
+
+    /**
+     * A channel which FMOD reported as ended, see channelCallback()
+     */
+    struct EndedVoice {
+        // slot index of the voice, stored in the channel's user data
+        uint32_t voiceIndex = 0;
+        FMOD::Channel* channel = nullptr;
+    };
+
+    /**
+     * An FMOD Studio event and its instance
+     */
+    struct EventData {
+        FMOD::Studio::EventDescription* description = nullptr;
+        // path the event was loaded with
+        std::string name;
+        // loads of the event which haven't been matched by unloadFMODStudioEvent()
+        int refCount = 1;
+        // set once preloadEventSampleData() has called loadSampleData(), which unloading the event undoes
+        bool sampleDataRequested = false;
+        // instance played by playEvent()
+        FMOD::Studio::EventInstance* instance = nullptr;
+        // idle instances for playEventInstance()
+        std::vector<FMOD::Studio::EventInstance*> pool;
+        // the description's parameters, resolved when the event is loaded
+        std::vector<std::string> parameterNames;
+        std::vector<FMOD_STUDIO_PARAMETER_ID> parameterIDs;
+        // default value of every parameter the instance owns, overridden by the values passed to
+        // loadFMODStudioEvent(), reapplied to instances taken from the pool
+        std::vector<FMOD_STUDIO_PARAMETER_ID> defaultParameterIDs;
+        std::vector<float> defaultParameterValues;
+        // called once sample data requested with preloadEventSampleData() has loaded
+        std::vector<EventLoadedCallback> onSampleDataLoaded;
+    };
+
+    /**
+     * A loaded FMOD Studio bank
+     */
+    struct BankData {
+        FMOD::Studio::Bank* bank = nullptr;
+        // loads of the bank which haven't been matched by unloadFMODStudioBank()
+        int refCount = 1;
+        // size of the bank file
+        unsigned long long fileBytes = 0;
+        BankMemorySource source = BankMemorySource::HEAP;
+        // mapping FMOD reads the bank from, for banks loaded with loadFMODStudioBankMapped() which aren't in a pack
+        std::unique_ptr<MappedFile> mapping;
+    };
+
+    /**
+     * A bank which has been unloaded but may still be read by FMOD until it finishes unloading
+     */
+    struct UnloadingBank {
+        FMOD::Studio::Bank* bank = nullptr;
+        std::unique_ptr<MappedFile> mapping;
+    };
+
+    /**
+     * A bank loading asynchronously, see loadFMODStudioBankAsync()
+     */
+    struct LoadingBank {
+        std::string filePath;
+        FMOD::Studio::Bank* bank = nullptr;
+        bool preloadSampleData = false;
+        // set once the bank's metadata has loaded and its sample data has been requested
+        bool sampleDataRequested = false;
+        std::vector<BankLoadedCallback> onLoaded;
+    };
+
+    /**
+     * Progress of a loadManifest() call, shared by the callbacks of the loads it started
+     */
+    struct ManifestLoad {
+        AudioManifest manifest;
+        size_t pendingBanks = 0;
+        size_t pendingEvents = 0;
+        bool failed = false;
+        // set once onLoaded has been called
+        bool finished = false;
+        // set by unloadManifest(), after which the load's callbacks do nothing
+        bool unloaded = false;
+        ManifestLoadedCallback onLoaded;
+        // references the load holds, released by unloadManifest()
+        std::vector<std::string> heldBanks;
+        std::vector<EventHandle> heldEvents;
+    };
+
+    /**
+     * A parameter value waiting for flushEventParameters()
+     */
+    struct PendingParameter {
+        FMOD::Studio::EventInstance* instance = nullptr;
+        FMOD_STUDIO_PARAMETER_ID id = { };
+        float value = 0.0f;
+    };
+
+    /**
+     * An instance started with playEventInstance()
+     */
+    struct EventInstanceData {
+        FMOD::Studio::EventInstance* instance = nullptr;
+        // event whose pool the instance returns to
+        EventHandle event;
+    };
+
+    /**
+     * A pooled event instance which FMOD reported as stopped, see eventCallback()
+     */
+    struct StoppedEventInstance {
+        // slot index of the instance, stored in the instance's user data
+        uint32_t instanceIndex = 0;
+        FMOD::Studio::EventInstance* instance = nullptr;
+    };
+
+    /**
+     * A deferred playback command pushed by the queue*() methods
+     */
+    struct Command {
+        enum Type : unsigned char {
+            PLAY_SOUND, STOP_SOUND, SET_VOLUME, SET_3D_POSITION, PLAY_EVENT, STOP_EVENT, SET_EVENT_PARAM
+        };
+        Type type = PLAY_SOUND;
+        SoundHandle sound;
+        VoiceHandle voice;
+        EventHandle event;
+        // volume, or the event parameter value
+        float value = 0.0f;
+        float reverbAmount = 0.0f;
+        unsigned int fadeSampleLength = 0;
+        Vec3 position;
+        char parameterName[MAX_QUEUED_PARAM_NAME] = { };
+    };
+
+    /**
+     * Executes every command queued before the call. Called by update()
+     */
+    void processCommands();
+
+    /**
+     * Creates the FMOD::Sound for a SoundInfo and adds it to the sound cache
+     * @param nonBlocking - open the file on FMOD's loader thread instead of the calling thread
+     */
+    AudioResult<SoundHandle> createSound(SoundInfo& soundInfo, bool nonBlocking, SoundLoadPolicy policy);
+
+    /**
+     * Resolves SoundLoadPolicy::AUTO to a concrete policy based on the file's size, in a pack or on disk
+     */
+    SoundLoadPolicy resolveLoadPolicy(const char* filePath, SoundLoadPolicy policy);
+
+    /**
+     * Applies the settings that require an opened FMOD::Sound, and marks the sound as ready
+     */
+    void finishLoadingSound(SoundData& soundData);
+
+    /**
+     * Polls sounds being loaded asynchronously, starting their queued plays once they are ready.
+     * Called by update()
+     */
+    void updateLoadingSounds();
+
+    /**
+     * Finishes an asynchronous sound load if the sound has opened: removes it from loadingSounds, starts
+     * its queued plays and calls its callbacks, or evicts it if the open failed
+     * @return FMOD_ERR_NOTREADY while the sound is still opening, otherwise the result of the open
+     */
+    FMOD_RESULT completeSoundLoad(SoundHandle handle);
+
+    /**
+     * Checks on banks and event sample data which are loading, finishing any which are done. Called by update()
+     */
+    void updateLoadingBanks();
+
+    /**
+     * Tracks a bank whose non-blocking load has been started until it finishes loading
+     */
+    void trackLoadingBank(const char* filePath, BankData bankData, BankLoadedCallback onLoaded, bool preloadSampleData);
+
+    /**
+     * Releases an event's instances and removes it, regardless of its reference count
+     */
+    void releaseEvent(EventHandle event);
+
+    /**
+     * Appends the descriptions of the events in a bank, if it has finished loading
+     */
+    void getBankEvents(FMOD::Studio::Bank* bank, std::vector<FMOD::Studio::EventDescription*>& descriptions);
+
+    /**
+     * Unloads a bank, keeping any mapping it's read from until FMOD has finished unloading it
+     */
+    FMOD_RESULT beginUnloadingBank(BankData& bankData);
+
+    /**
+     * Loads a manifest's events and preloads their sample data, once its banks have loaded
+     */
+    void preloadManifestEvents(const std::shared_ptr<ManifestLoad>& load);
+
+    /**
+     * Estimates the memory used by an opened sound from its format, length and load policy
+     */
+    unsigned long long estimateSoundMemory(const SoundData& soundData);
+
+    /**
+     * Adds a voice to the voice table, counting it against its sound so the sound isn't evicted.
+     * 3D voices also get an emitter at the given position.
+     */
+    VoiceHandle addVoice(const VoiceData& voiceData, bool is3D, Vec3 position);
+
+    /**
+     * Returns a voice's 3D position, or the origin for 2D voices
+     */
+    Vec3 getVoicePosition(const VoiceData& voiceData);
+
+    /**
+     * Sends the 3D attributes of emitters which changed since the last update to FMOD. Called by update()
+     */
+    void flushEmitters();
+
+    /**
+     * Removes a voice from the voice table. Does not stop its channel
+     */
+    void removeVoice(VoiceHandle voice);
+
+    /**
+     * Moves a sound to the front of the LRU list
+     */
+    void touchSound(SoundData& soundData);
+
+    /**
+     * Checks if a sound may be evicted: it has no references, no voices and isn't loading
+     */
+    bool soundIsEvictable(const SoundData& soundData);
+
+    /**
+     * Releases a sound and removes it from the sound cache
+     */
+    void evictSound(SoundHandle sound);
+
+    /**
+     * Evicts least recently used sounds until the cache fits the sound memory budget. Called by update()
+     */
+    void enforceSoundMemoryBudget();
+
+    /**
+     * Makes room for a new voice of a sound if it or its category is at its voice limit, by stealing a voice.
+     * @return false if the new voice shouldn't be played
+     */
+    bool enforceVoiceLimits(SoundHandle sound, const SoundData& soundData);
+
+    /**
+     * Chooses the voice to steal among the voices of a sound (if category < 0) or of a category
+     * @return an invalid handle if no voice may be stolen
+     */
+    VoiceHandle findVoiceToSteal(SoundHandle sound, int category, VoiceStealPolicy policy, int newPriority);
+
+    /**
+     * Returns the voice category, creating it if needed
+     */
+    VoiceCategory& getVoiceCategory(int category);
+
+    /**
+     * Starts voices for ambient emitters which came into range of the listener and stops the voices of
+     * emitters which left it. Looping emitters whose voice was stolen are restarted once a voice is free.
+     * Called by update()
+     */
+    void updateEmitters();
+
+    /**
+     * Checks if an emitter in range has lost the voice of its looping sound, e.g. to voice stealing,
+     * and the sound's voice limits now leave room to restart it
+     */
+    bool loopingVoiceLost(const EmitterRegistry::Emitter& emitter);
+
+    /**
+     * Removes the voices whose channels ended since the last update. Called by update()
+     */
+    void processEndedVoices();
+
+    /**
+     * FMOD channel callback which queues ended voices for removal. FMOD calls this from the thread updating
+     * the core system, which is Studio's update thread, so it only pushes onto a lock-free queue.
+     */
+    static FMOD_RESULT F_CALL channelCallback(FMOD_CHANNELCONTROL* channelControl, FMOD_CHANNELCONTROL_TYPE controlType,
+                                              FMOD_CHANNELCONTROL_CALLBACK_TYPE callbackType, void* commandData1, void* commandData2);
+
+    /**
+     * FMOD Studio event callback which queues stopped pooled instances for recycling. Like channelCallback(),
+     * FMOD calls it from Studio's update thread, so it only pushes onto a lock-free queue.
+     */
+    static FMOD_RESULT F_CALL eventCallback(FMOD_STUDIO_EVENT_CALLBACK_TYPE type, FMOD_STUDIO_EVENTINSTANCE* event, void* parameters);
+
+    /**
+     * Returns stopped instances to their event's pool. Called by update()
+     */
+    void processStoppedEventInstances();
+
+    /**
+     * Returns a stopped instance to its event's pool, or releases it if the event is gone, invalidating its handle
+     */
+    void recycleEventInstance(EventInstanceHandle instance);
+
+    /**
+     * Finds a parameter in an event's cached parameters
+     * @return the parameter's index, or -1 if the event has no parameter with that name
+     */
+    int findEventParameter(const EventData& eventData, const char* parameterName);
+
+    /**
+     * Sets a parameter of an instance at the next flushEventParameters(). Names missing from the event's
+     * cache are resolved through FMOD, and still queued so writes reach FMOD in the order they were made
+     */
+    void setEventParameter(const EventData& eventData, FMOD::Studio::EventInstance* instance, const char* parameterName, float value);
+
+    /**
+     * Sends the parameter values set since the last update to FMOD, one setParametersByIDs() call per
+     * instance, keeping only the last value set for each parameter. Called by update()
+     */
+    void flushEventParameters();
+
+    /**
+     * Records this frame's counters into the rolling windows of getStats(). Called at the end of update()
+     * @param updateMs - time update() took before this call
+     */
+    void recordStats(float updateMs);
+
+    /**
+     * Starts a pooled instance of an event for playEventInstance()
+     * @param position - 3D position of the instance, or nullptr to leave it unpositioned
+     */
+    AudioResult<EventInstanceHandle> startEventInstance(EventHandle event, const Vec3* position);
+
+    /**
+     * Creates an instance of an event which reports stopping, so it can be returned to the pool
+     * @return FMOD_OK, or the FMOD error creating the instance
+     */
+    FMOD_RESULT createPooledInstance(EventData& eventData, FMOD::Studio::EventInstance** instance);
+
+    /**
+     * Takes an idle instance of an event from its pool, creating one if the pool is empty
+     * @return FMOD_OK, or the FMOD error creating the instance
+     */
+    FMOD_RESULT takePooledInstance(EventData& eventData, FMOD::Studio::EventInstance** instance);
+
+    // The initialized audio engine, for FMOD callbacks
+    static AudioEngine* callbackEngine;
+
+    /**
+     * Starts an FMOD::Channel playing a voice's ready sound
+     * @return FMOD_OK, or the FMOD error if the channel couldn't be started
+     */
+    FMOD_RESULT startVoice(VoiceHandle voice);
+
     /**
      * Checks if a sound file is in the soundCache
      */
     bool soundLoaded(SoundInfo soundInfo);
 
     /**
-     * Sets the 3D position of a sound
+     * Sets the 3D position and velocity of a sound
      */
-    void set3dChannelPosition(SoundInfo soundInfo, FMOD::Channel* channel);
+    void set3dChannelPosition(Vec3 position, Vec3 velocity, FMOD::Channel* channel);
 
     /**
-     * Initializes the reverb effect
+     * Applies finished occlusion results and requests rays for the voices which need them most. Called by update()
      */
-    void initReverb();
+    void updateOcclusion();
+
+    /**
+     * Adds the concert hall zone reverbAmount sends go to while no reverb zones have been added
+     */
+    void addDefaultReverbZone();
+
+    /**
+     * Derives the listeners' velocities and sends their attributes to FMOD. Called by update()
+     */
+    void updateListeners(float deltaSeconds);
+
+    /**
+     * Finds the listener nearest to a position
+     * @return the squared distance to it
+     */
+    float nearestListener(Vec3 position, Vec3* listenerPosition = nullptr) const;
 
     /**
      * Prints debug info about an FMOD event description
@@ -202,63 +1257,190 @@ private:
     // FMOD's low-level audio system which plays audio files and is obtained from Studio System
     FMOD::System* lowLevelSystem = nullptr;          
 
-    // Max FMOD::Channels for the audio engine 
+    // Files below this size are decompressed by SoundLoadPolicy::AUTO
+    unsigned long long compressedThresholdBytes = 256 * 1024;
+
+    // Files at or above this size are streamed by SoundLoadPolicy::AUTO
+    unsigned long long streamThresholdBytes = 2 * 1024 * 1024;
+
+    // Max commands which can be queued between two update() calls
+    static const unsigned int COMMAND_QUEUE_CAPACITY = 4096;
+
+    // Default max FMOD::Channels for the audio engine, see AudioEngineSettings::maxVoices
     static const unsigned int MAX_AUDIO_CHANNELS = 1024; 
+
+    // Voice limits of each category, indexed by category
+    std::vector<VoiceCategory> voiceCategories;
+
+    // Incremented for every voice played, gives VoiceData::startOrder
+    unsigned long long voiceStartCounter = 0;
     
     // Units per meter.  I.e feet would = 3.28.  centimeters would = 100.
     const float DISTANCEFACTOR = 1.0f;  
  
-    // Listener head position, initialized to default value
-    FMOD_VECTOR listenerpos = { 0.0f, 0.0f, -1.0f * DISTANCEFACTOR };
-    
-    // Listener forward vector, initialized to default value
-    FMOD_VECTOR forward     = { 0.0f, 0.0f, 1.0f };
-    
-    // Listener upwards vector, initialized to default value
-    FMOD_VECTOR up          = { 0.0f, 1.0f, 0.0f };
+    // Listeners, of which the first numListeners are in use
+    Listener listeners[FMOD_MAX_LISTENERS];
+
+    // Number of listeners in use, see set3DNumListeners()
+    int numListeners = 1;
+
+    // Positions of the listeners in use, in the form the culling passes take
+    Vec3 listenerPositions[FMOD_MAX_LISTENERS] = { { 0.0f, 0.0f, -1.0f } };
+
+    // Time of the previous update(), for measuring the frame time
+    std::chrono::steady_clock::time_point lastUpdateTime;
+
+    // Set once update() has run, the first update has no frame time to measure
+    bool hasUpdated = false;
+
+    // File system serving FMOD's file reads from mounted pack files
+    PackFileSystem packFileSystem;
 
     // Main group for low level system which all sounds go though
     FMOD::ChannelGroup* mastergroup = 0;
 
-    // Low-level system reverb TODO add multi-reverb support
-	FMOD::Reverb3D* reverb;
+    // Reverb zones, of which only the nearest to the listener are backed by real reverbs
+    ReverbZoneManager reverbZones;
+
+    // Zone added while the caller has added none, so reverbAmount sends still reach a reverb
+    ReverbZoneHandle defaultReverbZone;
+
+    // Casts occlusion rays against level geometry on its own thread
+    OcclusionSystem occlusion;
 
-	// Reverb origin position
-	FMOD_VECTOR revPos = { 0.0f, 0.0f, 0.0f };
+    // See AudioEngineSettings::occlusionRaysPerUpdate
+    int occlusionRaysPerUpdate = 64;
 
-	// reverb min, max distances
-	float revMinDist = 10.0f, revMaxDist = 50.0f;
+    // Reused by updateOcclusion(): priority and dense index of each voice which could be sent a ray
+    std::vector<std::pair<float, uint32_t>> occlusionCandidates;
+
+    // Rolling windows of the per-frame counters reported by getStats()
+    AudioStatsHistory statsHistory;
+
+    // FMOD's file read totals at the previous recordStats(), to turn them into per-frame values
+    long long lastSampleBytesRead = 0;
+    long long lastStreamBytesRead = 0;
+    long long lastOtherBytesRead = 0;
+
+    // Most commands found waiting by processCommands()
+    size_t commandQueueHighWater = 0;
 
     // flag tracking if the Audio Engin is muted
     bool muted = false;
 
     /*
-     * Map which caches FMOD Low-Level sounds
-     * Key is the SoundInfo's uniqueKey field.
-     * Value is the FMOD::Sound* to be played back.
-     * TODO Refactor to use numeric UID as key
+     * Slot map which caches FMOD Low-Level sounds, addressed by SoundHandle
+     */
+    SlotMap<SoundData, SoundHandle> sounds;
+
+    /*
+     * Load-time lookup from the SoundInfo's uniqueKey field to the sound's handle
+     */
+    std::unordered_map<std::string, SoundHandle> soundHandles;
+
+    /*
+     * Sounds ordered from most to least recently played, for eviction
+     */
+    std::list<SoundHandle> soundLRU;
+
+    // Memory budget for cached sounds, 0 is unlimited
+    unsigned long long soundMemoryBudget = 0;
+
+    // Estimated memory used by cached sounds
+    unsigned long long soundMemoryUsed = 0;
+
+    /*
+     * Sounds which are still being loaded asynchronously
      */
-    std::map<std::string, FMOD::Sound*> sounds;
+    std::vector<SoundHandle> loadingSounds;
 
     /*
-     * Map which stores the current playback channels of any playing sound loop
+     * Slot map which stores the playback channels of every voice, addressed by VoiceHandle.
+     * Voices are removed when their channel ends, so the table only holds active voices.
+     */
+    SlotMap<VoiceData, VoiceHandle> voices;
+
+    /*
+     * 3D state of the voices in the voice table, stored as arrays for batched updates
+     */
+    EmitterStore emitters;
+
+    /*
+     * Persistent ambient emitters, culled by distance to the listener
+     */
+    EmitterRegistry emitterRegistry;
+
+    /*
+     * Channels which ended, pushed from FMOD's channel callback and drained by update()
+     */
+    MPSCQueue<EndedVoice> endedVoices;
+
+    /*
+     * Map which stores the voice of any sound loop started through the SoundInfo API
      * Key is the SoundInfo's uniqueKey field.
-     * Value is the FMOD::Channel* the FMOD::Sound* is playing back on.
+     * Value is the handle of the voice the sound is playing back on.
+     */
+    std::unordered_map<std::string, VoiceHandle> loopsPlaying;
+
+    /*
+     * Commands pushed by the queue*() methods from any thread, drained by update()
      */
-    std::map<std::string, FMOD::Channel*> loopsPlaying;
+    MPSCQueue<Command> commands;
 
     /*
      * Map which stores the soundbanks loaded with loadFMODStudioBank()
      */
-    std::map<std::string, FMOD::Studio::Bank*> soundBanks;
-    
+    std::map<std::string, BankData> soundBanks;
+
+    /*
+     * Banks which are unloading, whose mappings FMOD may still be reading
+     */
+    std::vector<UnloadingBank> unloadingBanks;
+
+    /*
+     * Banks loading asynchronously, which are also in soundBanks
+     */
+    std::vector<LoadingBank> loadingBanks;
+
+    /*
+     * Manifests loaded with loadManifest(), kept so unloadManifest() can release what they loaded
+     */
+    std::vector<std::shared_ptr<ManifestLoad>> manifestLoads;
+
     /*
-     * Map which stores event descriptions created during loadFMODStudioEvent()
+     * Events whose sample data is loading, see preloadEventSampleData()
      */
-    std::map<std::string, FMOD::Studio::EventDescription*> eventDescriptions;
+    std::vector<EventHandle> loadingSampleData;
     
     /*
-     * Map which stores event instances created during loadFMODStudioEvent()
+     * Slot map which stores the event descriptions and instances created during loadFMODStudioEvent()
      */
-    std::map<std::string, FMOD::Studio::EventInstance*> eventInstances;
+    SlotMap<EventData, EventHandle> events;
+
+    /*
+     * Load-time lookup from event name to the event's handle
+     */
+    std::unordered_map<std::string, EventHandle> eventHandles;
+
+    /*
+     * Instances started with playEventInstance(), addressed by EventInstanceHandle
+     */
+    SlotMap<EventInstanceData, EventInstanceHandle> eventInstances;
+
+    /*
+     * Pooled instances which stopped, pushed from FMOD's event callback and drained by update()
+     */
+    MPSCQueue<StoppedEventInstance> stoppedEventInstances;
+
+    // Set when a stopped notification didn't fit in stoppedEventInstances, update() then checks every instance
+    std::atomic<bool> stoppedEventsDropped { false };
+
+    /*
+     * Parameter values set since the last update, see flushEventParameters()
+     */
+    std::vector<PendingParameter> pendingParameters;
+
+    // Reused by flushEventParameters() to build each instance's batch
+    std::vector<FMOD_STUDIO_PARAMETER_ID> parameterBatchIDs;
+    std::vector<float> parameterBatchValues;
 };
@@ -0,0 +1,74 @@
+///
+/// @file AudioErrors.cpp
+///
+#include "AudioErrors.h"
+#include <FMOD/fmod_errors.h>
+#include "Logger.h"
+
+namespace {
+
+// Every site which has failed, newest first. Sites are static locals so they're never removed.
+std::atomic<FMODErrorSite*> errorSites { nullptr };
+
+FMODErrorCallback errorCallback;
+
+}
+
+FMODErrorSite::FMODErrorSite(const char* file, int line, const char* call) : file(file), line(line), call(call) {
+    next = errorSites.load(std::memory_order_relaxed);
+    while (!errorSites.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+void setFMODErrorCallback(FMODErrorCallback callback) {
+    errorCallback = callback;
+}
+
+std::vector<FMODErrorSiteStats> getFMODErrorSites() {
+    std::vector<FMODErrorSiteStats> stats;
+    for (FMODErrorSite* site = errorSites.load(std::memory_order_acquire); site; site = site->next) {
+        unsigned long long count = site->count.load(std::memory_order_relaxed);
+        if (count == 0)
+            continue;
+        FMODErrorSiteStats siteStats;
+        siteStats.file = site->file;
+        siteStats.line = site->line;
+        siteStats.call = site->call;
+        siteStats.count = count;
+        siteStats.lastResult = site->lastResult.load(std::memory_order_relaxed);
+        stats.push_back(siteStats);
+    }
+    return stats;
+}
+
+void resetFMODErrorCounts() {
+    for (FMODErrorSite* site = errorSites.load(std::memory_order_acquire); site; site = site->next) {
+        site->count.store(0, std::memory_order_relaxed);
+        site->reportedCount.store(0, std::memory_order_relaxed);
+        site->reportedTime.store(0, std::memory_order_relaxed);
+    }
+}
+
+FMOD_RESULT reportFMODError(FMODErrorSite& site, FMOD_RESULT result) {
+    unsigned long long count = site.count.fetch_add(1, std::memory_order_relaxed) + 1;
+    site.lastResult.store(result, std::memory_order_relaxed);
+    if (errorCallback)
+        errorCallback(site, result);
+
+    long long now = std::chrono::steady_clock::now().time_since_epoch().count();
+    long long interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(FMOD_ERROR_REPORT_INTERVAL).count();
+    long long reported = site.reportedTime.load(std::memory_order_relaxed);
+    bool firstFailure = site.reportedCount.load(std::memory_order_relaxed) == 0;
+    // only the thread which claims the report time logs, so concurrent failures aren't reported twice
+    if ((!firstFailure && now - reported < interval) ||
+        !site.reportedTime.compare_exchange_strong(reported, now, std::memory_order_relaxed))
+        return result;
+    unsigned long long previous = site.reportedCount.exchange(count, std::memory_order_relaxed);
+    unsigned long long suppressed = count > previous + 1 ? count - previous - 1 : 0;
+    if (suppressed > 0)
+        AUDIO_LOG_ERROR("FMOD ERROR: %s [Line %d] %s failed with %d - %s (%llu more failures since the last report)",
+                        site.file, site.line, site.call, int(result), FMOD_ErrorString(result), suppressed);
+    else
+        AUDIO_LOG_ERROR("FMOD ERROR: %s [Line %d] %s failed with %d - %s",
+                        site.file, site.line, site.call, int(result), FMOD_ErrorString(result));
+    return result;
+}
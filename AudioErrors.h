@@ -0,0 +1,128 @@
+#pragma once
+///
+/// @file AudioErrors.h
+///
+/// FMOD error reporting. Every ERRCHECK() call site keeps its own failure count. The first failure at a
+/// site is logged straight away and later ones at most once per FMOD_ERROR_REPORT_INTERVAL together with
+/// the number suppressed, so a call which fails every frame costs an atomic increment, not a formatted
+/// message. Counts can be read back with getFMODErrorSites() and every failure can be forwarded to an
+/// error callback. Functions which can fail return the FMOD_RESULT, or an AudioResult holding either
+/// their value or the error, so callers can react to failures rather than only reading about them.
+///
+#include <FMOD/fmod_common.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+// Minimum time between two log messages for the same call site
+const std::chrono::milliseconds FMOD_ERROR_REPORT_INTERVAL(1000);
+
+/**
+ * A call site of ERRCHECK(), created the first time the call there fails
+ */
+struct FMODErrorSite {
+    FMODErrorSite(const char* file, int line, const char* call);
+
+    FMODErrorSite(const FMODErrorSite&) = delete;
+    FMODErrorSite& operator=(const FMODErrorSite&) = delete;
+
+    const char* file;
+    int line;
+    // source text of the checked expression
+    const char* call;
+
+    std::atomic<unsigned long long> count { 0 };
+    std::atomic<FMOD_RESULT> lastResult { FMOD_OK };
+    // count when the site was last logged, and when (steady clock ticks), for rate limiting
+    std::atomic<unsigned long long> reportedCount { 0 };
+    std::atomic<long long> reportedTime { 0 };
+
+    // next site in the list of every site which has failed
+    FMODErrorSite* next = nullptr;
+};
+
+/**
+ * Snapshot of a call site's failures, see getFMODErrorSites()
+ */
+struct FMODErrorSiteStats {
+    const char* file;
+    int line;
+    const char* call;
+    unsigned long long count;
+    FMOD_RESULT lastResult;
+};
+
+/**
+ * Called on the failing thread for every failed ERRCHECK(), including the ones whose log message is
+ * rate limited. Must be thread safe, as FMOD calls are checked on FMOD's callback threads too.
+ */
+typedef std::function<void(const FMODErrorSite& site, FMOD_RESULT result)> FMODErrorCallback;
+
+/**
+ * Sets the error callback, or removes it when given nullptr. Not synchronized with failing calls,
+ * so set it before AudioEngine::init() or while no other thread is using the engine.
+ */
+void setFMODErrorCallback(FMODErrorCallback callback);
+
+/**
+ * Every call site which has failed since the process started or resetFMODErrorCounts(), with its count
+ */
+std::vector<FMODErrorSiteStats> getFMODErrorSites();
+
+/**
+ * Zeroes the failure count of every call site
+ */
+void resetFMODErrorCounts();
+
+/**
+ * Counts a failure at a call site, reports it to the error callback and, unless rate limited, logs it.
+ * Called by ERRCHECK(), which only creates the site once the call there has failed.
+ * @return result
+ */
+FMOD_RESULT reportFMODError(FMODErrorSite& site, FMOD_RESULT result);
+
+/**
+ * Checks the FMOD_RESULT of a call, reporting failures against this call site. Evaluates to the result.
+ */
+#define ERRCHECK(_result) ([&]() -> FMOD_RESULT {                            \
+        FMOD_RESULT _errcheckResult = (_result);                             \
+        if (_errcheckResult == FMOD_OK)                                      \
+            return FMOD_OK;                                                  \
+        static FMODErrorSite _errcheckSite(__FILE__, __LINE__, #_result);    \
+        return reportFMODError(_errcheckSite, _errcheckResult);              \
+    }())
+
+/**
+ * Either the value a call produced or the FMOD_RESULT it failed with, in the manner of std::expected
+ */
+template <typename T>
+class AudioResult {
+public:
+    AudioResult(const T& value) : storedValue(value), result(FMOD_OK) {}
+
+    /**
+     * @param error - why the call failed, must not be FMOD_OK
+     */
+    AudioResult(FMOD_RESULT error) : result(error) {}
+
+    bool hasValue() const { return result == FMOD_OK; }
+    explicit operator bool() const { return hasValue(); }
+
+    /**
+     * The value, only meaningful when hasValue()
+     */
+    const T& value() const { return storedValue; }
+    const T& operator*() const { return storedValue; }
+
+    T valueOr(const T& fallback) const { return hasValue() ? storedValue : fallback; }
+
+    /**
+     * FMOD_OK if the call succeeded
+     */
+    FMOD_RESULT error() const { return result; }
+
+private:
+    T storedValue = T();
+    FMOD_RESULT result;
+};
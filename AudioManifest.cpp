@@ -0,0 +1,33 @@
+///
+/// @file AudioManifest.cpp
+///
+#include "AudioManifest.h"
+#include <fstream>
+#include <sstream>
+#include "Logger.h"
+
+bool AudioManifest::read(const char* filePath) {
+    std::ifstream file(filePath);
+    if (!file)
+        return false;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        std::string kind, path;
+        if (!(words >> kind) || kind[0] == '#')
+            continue;
+        std::getline(words >> std::ws, path);
+        // tolerate files saved with Windows line endings
+        while (!path.empty() && (path.back() == '\r' || path.back() == ' ' || path.back() == '\t'))
+            path.pop_back();
+        if (kind == "bank" && !path.empty())
+            banks.push_back(path);
+        else if (kind == "event" && !path.empty())
+            events.push_back(path);
+        else
+            AUDIO_LOG_WARNING("AudioManifest: Ignoring line %d of %s", lineNumber, filePath);
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+///
+/// @file AudioManifest.h
+///
+/// List of the banks a level needs and the events whose sample data should be in memory before the level
+/// starts, see AudioEngine::loadManifest(). Manifest files are plain text with one entry per line:
+///     # comment
+///     bank Assets/Banks/Forest.bank
+///     event event:/Ambience/Birds
+///
+#include <string>
+#include <vector>
+
+struct AudioManifest {
+    // bank file paths, loaded asynchronously
+    std::vector<std::string> banks;
+    // event paths, whose sample data is preloaded once the banks have loaded
+    std::vector<std::string> events;
+
+    /**
+     * Adds the entries of a manifest file
+     * @return false if the file couldn't be opened
+     */
+    bool read(const char* filePath);
+};
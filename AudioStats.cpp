@@ -0,0 +1,91 @@
+///
+/// @file AudioStats.cpp
+///
+#include "AudioStats.h"
+#include <algorithm>
+
+void RollingStat::setCapacity(size_t capacity) {
+    samples.assign(capacity, 0.0f);
+    scratch.reserve(capacity);
+    clear();
+}
+
+StatSummary RollingStat::summarize() const {
+    StatSummary summary;
+    if (count == 0)
+        return summary;
+    summary.current = samples[next == 0 ? samples.size() - 1 : next - 1];
+    // until the window fills the samples are at the start of the buffer, afterwards every sample is used
+    scratch.assign(samples.begin(), samples.begin() + count);
+    double total = 0.0;
+    summary.min = scratch[0];
+    summary.max = scratch[0];
+    for (float value : scratch) {
+        total += value;
+        summary.min = std::min(summary.min, value);
+        summary.max = std::max(summary.max, value);
+    }
+    summary.average = float(total / double(count));
+    // nearest rank percentile
+    size_t rank = (count * 99 + 99) / 100;
+    std::nth_element(scratch.begin(), scratch.begin() + (rank - 1), scratch.end());
+    summary.p99 = scratch[rank - 1];
+    return summary;
+}
+
+void AudioStatsHistory::setCapacity(size_t frames) {
+    dspCPU.setCapacity(frames);
+    streamCPU.setCapacity(frames);
+    geometryCPU.setCapacity(frames);
+    fmodUpdateCPU.setCapacity(frames);
+    studioCPU.setCapacity(frames);
+    engineUpdateMs.setCapacity(frames);
+    realVoices.setCapacity(frames);
+    virtualVoices.setCapacity(frames);
+    sampleBytesRead.setCapacity(frames);
+    streamBytesRead.setCapacity(frames);
+    otherBytesRead.setCapacity(frames);
+}
+
+void AudioStatsHistory::add(const AudioFrameSample& sample) {
+    dspCPU.add(sample.dspCPU);
+    streamCPU.add(sample.streamCPU);
+    geometryCPU.add(sample.geometryCPU);
+    fmodUpdateCPU.add(sample.fmodUpdateCPU);
+    studioCPU.add(sample.studioCPU);
+    engineUpdateMs.add(sample.engineUpdateMs);
+    realVoices.add(sample.realVoices);
+    virtualVoices.add(sample.virtualVoices);
+    sampleBytesRead.add(sample.sampleBytesRead);
+    streamBytesRead.add(sample.streamBytesRead);
+    otherBytesRead.add(sample.otherBytesRead);
+}
+
+void AudioStatsHistory::summarize(AudioStats& stats) const {
+    stats.frames = dspCPU.size();
+    stats.dspCPU = dspCPU.summarize();
+    stats.streamCPU = streamCPU.summarize();
+    stats.geometryCPU = geometryCPU.summarize();
+    stats.fmodUpdateCPU = fmodUpdateCPU.summarize();
+    stats.studioCPU = studioCPU.summarize();
+    stats.engineUpdateMs = engineUpdateMs.summarize();
+    stats.realVoices = realVoices.summarize();
+    stats.virtualVoices = virtualVoices.summarize();
+    stats.sampleBytesRead = sampleBytesRead.summarize();
+    stats.streamBytesRead = streamBytesRead.summarize();
+    stats.otherBytesRead = otherBytesRead.summarize();
+}
+
+void AudioStatsHistory::clear() {
+    dspCPU.clear();
+    streamCPU.clear();
+    geometryCPU.clear();
+    fmodUpdateCPU.clear();
+    studioCPU.clear();
+    engineUpdateMs.clear();
+    realVoices.clear();
+    virtualVoices.clear();
+    sampleBytesRead.clear();
+    streamBytesRead.clear();
+    otherBytesRead.clear();
+}
@@ -0,0 +1,159 @@
+#pragma once
+///
+/// @file AudioStats.h
+///
+/// Performance telemetry for the audio engine, see AudioEngine::getStats(). Each update() records one
+/// AudioFrameSample of cheap FMOD counters into fixed size rolling windows. Min, average, max and 99th
+/// percentile are only computed when the stats are read, so recording costs a few getter calls per frame.
+///
+#include <cstddef>
+#include <vector>
+
+/**
+ * Summary of a value over the rolling window
+ */
+struct StatSummary {
+    // the most recent sample
+    float current = 0.0f;
+    float min = 0.0f;
+    float average = 0.0f;
+    float max = 0.0f;
+    float p99 = 0.0f;
+};
+
+/**
+ * Fixed size window of the most recent samples of one value
+ */
+class RollingStat {
+public:
+    /**
+     * Sets how many samples the window holds, discarding the samples already recorded
+     */
+    void setCapacity(size_t capacity);
+
+    void add(float value) {
+        if (samples.empty())
+            return;
+        samples[next] = value;
+        next = next + 1 == samples.size() ? 0 : next + 1;
+        count += count < samples.size() ? 1 : 0;
+    }
+
+    StatSummary summarize() const;
+
+    size_t size() const { return count; }
+
+    void clear() { next = 0; count = 0; }
+
+private:
+    std::vector<float> samples;
+    // where the next sample is written
+    size_t next = 0;
+    size_t count = 0;
+    // sorted copy of the samples for the percentile, kept so summarize() doesn't allocate
+    mutable std::vector<float> scratch;
+};
+
+/**
+ * Counters recorded by AudioEngine::update() each frame
+ */
+struct AudioFrameSample {
+    // CPU usage in percent, from Studio::System::getCPUUsage()
+    float dspCPU = 0.0f;
+    float streamCPU = 0.0f;
+    float geometryCPU = 0.0f;
+    float fmodUpdateCPU = 0.0f;
+    float studioCPU = 0.0f;
+    // wall time of AudioEngine::update() on the calling thread
+    float engineUpdateMs = 0.0f;
+    float realVoices = 0.0f;
+    float virtualVoices = 0.0f;
+    // bytes read from files since the previous frame
+    float sampleBytesRead = 0.0f;
+    float streamBytesRead = 0.0f;
+    float otherBytesRead = 0.0f;
+};
+
+/**
+ * Snapshot returned by AudioEngine::getStats()
+ */
+struct AudioStats {
+    // frames in the rolling windows
+    size_t frames = 0;
+
+    StatSummary dspCPU;
+    StatSummary streamCPU;
+    StatSummary geometryCPU;
+    StatSummary fmodUpdateCPU;
+    StatSummary studioCPU;
+    StatSummary engineUpdateMs;
+
+    StatSummary realVoices;
+    StatSummary virtualVoices;
+
+    StatSummary sampleBytesRead;
+    StatSummary streamBytesRead;
+    StatSummary otherBytesRead;
+    // bytes read since AudioEngine::init()
+    long long totalSampleBytesRead = 0;
+    long long totalStreamBytesRead = 0;
+    long long totalOtherBytesRead = 0;
+
+    // most commands waiting in the AudioEngine's command queue at the start of an update()
+    size_t commandQueueHighWater = 0;
+    size_t commandQueueCapacity = 0;
+    // FMOD Studio's own command buffer, from Studio::System::getBufferUsage()
+    int studioCommandQueuePeak = 0;
+    int studioCommandQueueCapacity = 0;
+    int studioCommandQueueStalls = 0;
+    int studioHandlePeak = 0;
+    int studioHandleCapacity = 0;
+
+    // memory allocated by FMOD, in total and at its peak
+    int fmodCurrentBytes = 0;
+    int fmodPeakBytes = 0;
+    // Studio's share of it, and the sample data Studio has loaded
+    int studioBytes = 0;
+    int studioSampleDataBytes = 0;
+    // estimated memory of cached sounds, and the budget they're evicted against (0 if unlimited)
+    unsigned long long soundCacheBytes = 0;
+    unsigned long long soundMemoryBudget = 0;
+    // size of the loaded bank files
+    unsigned long long bankFileBytes = 0;
+
+    size_t sounds = 0;
+    size_t voices = 0;
+    size_t emitters = 0;
+    size_t events = 0;
+    size_t eventInstances = 0;
+};
+
+/**
+ * Rolling windows of every AudioFrameSample value
+ */
+class AudioStatsHistory {
+public:
+    void setCapacity(size_t frames);
+
+    void add(const AudioFrameSample& sample);
+
+    /**
+     * Writes the summaries of every window to stats
+     */
+    void summarize(AudioStats& stats) const;
+
+    void clear();
+
+private:
+    RollingStat dspCPU;
+    RollingStat streamCPU;
+    RollingStat geometryCPU;
+    RollingStat fmodUpdateCPU;
+    RollingStat studioCPU;
+    RollingStat engineUpdateMs;
+    RollingStat realVoices;
+    RollingStat virtualVoices;
+    RollingStat sampleBytesRead;
+    RollingStat streamBytesRead;
+    RollingStat otherBytesRead;
+};
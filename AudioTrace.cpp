@@ -0,0 +1,161 @@
+///
+/// @file AudioTrace.cpp
+///
+#include "AudioTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Logger.h"
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    int64_t startNs;
+    int64_t durationNs;
+    // Chrome trace phase, 'X' for a span and 'i' for an instant
+    char phase;
+};
+
+/**
+ * Events recorded by one thread. Only the owning thread writes events and count; writeChromeJson()
+ * reads the first count events once recording has stopped.
+ */
+struct ThreadBuffer {
+    // allocated on the thread's first event, so threads which are only named cost nothing
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> count { 0 };
+    // capture the events belong to, buffers from earlier captures are reset on their next write
+    std::atomic<uint64_t> generation { 0 };
+    std::atomic<const char*> name { nullptr };
+    int threadId = 0;
+};
+
+// Buffers are never freed, a thread which exits leaves its events for the dump
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+std::atomic<uint64_t> generation { 0 };
+std::atomic<int64_t> captureStartNs { 0 };
+std::atomic<unsigned long long> dropped { 0 };
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& getThreadBuffer() {
+    if (!threadBuffer) {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffer->threadId = int(buffers.size()) + 1;
+        threadBuffer = buffer.get();
+        buffers.push_back(std::move(buffer));
+    }
+    return *threadBuffer;
+}
+
+void record(const char* name, int64_t startNs, int64_t durationNs, char phase) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    uint64_t current = generation.load(std::memory_order_acquire);
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (buffer.generation.load(std::memory_order_relaxed) != current) {
+        if (!buffer.events)
+            buffer.events.reset(new TraceEvent[AudioTrace::EVENTS_PER_THREAD]);
+        index = 0;
+        buffer.count.store(0, std::memory_order_relaxed);
+        buffer.generation.store(current, std::memory_order_release);
+    }
+    if (index >= AudioTrace::EVENTS_PER_THREAD) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = buffer.events[index];
+    event.name = name;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    event.phase = phase;
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void writeJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        if (static_cast<unsigned char>(*c) >= 0x20)
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+}
+
+std::atomic<bool> AudioTrace::enabled { false };
+
+void AudioTrace::start() {
+    captureStartNs.store(now(), std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    enabled.store(true, std::memory_order_release);
+}
+
+void AudioTrace::stop() {
+    enabled.store(false, std::memory_order_release);
+}
+
+void AudioTrace::setThreadName(const char* name) {
+    getThreadBuffer().name.store(name, std::memory_order_relaxed);
+}
+
+void AudioTrace::complete(const char* name, int64_t startNs, int64_t durationNs) {
+    record(name, startNs, durationNs, 'X');
+}
+
+void AudioTrace::instant(const char* name) {
+    record(name, now(), 0, 'i');
+}
+
+int64_t AudioTrace::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool AudioTrace::writeChromeJson(const char* filePath) {
+    FILE* file = fopen(filePath, "w");
+    if (!file)
+        return false;
+    uint64_t current = generation.load(std::memory_order_acquire);
+    int64_t originNs = captureStartNs.load(std::memory_order_relaxed);
+    bool first = true;
+    fputs("{\"traceEvents\":[\n", file);
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        if (const char* name = buffer->name.load(std::memory_order_relaxed)) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->threadId);
+            writeJsonString(file, name);
+            fputs("}}", file);
+            first = false;
+        }
+        if (buffer->generation.load(std::memory_order_acquire) != current)
+            continue; // nothing recorded this capture
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent& event = buffer->events[i];
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            writeJsonString(file, event.name);
+            double timestampUs = double(event.startNs - originNs) / 1000.0;
+            if (event.phase == 'X')
+                fprintf(file, ",\"cat\":\"audio\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        buffer->threadId, timestampUs, double(event.durationNs) / 1000.0);
+            else
+                fprintf(file, ",\"cat\":\"audio\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", buffer->threadId, timestampUs);
+            first = false;
+        }
+    }
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+    bool written = ferror(file) == 0;
+    written &= fclose(file) == 0;
+    unsigned long long droppedEvents = dropped.load(std::memory_order_relaxed);
+    if (droppedEvents > 0)
+        AUDIO_LOG_WARNING("AudioTrace: Dropped %llu events, a thread filled its buffer of %zu", droppedEvents, EVENTS_PER_THREAD);
+    return written;
+}
@@ -0,0 +1,99 @@
+#pragma once
+///
+/// @file AudioTrace.h
+///
+/// Timeline tracing of audio engine work, written out as Chrome trace JSON which chrome://tracing and
+/// Perfetto (ui.perfetto.dev) open directly. Each thread records into its own fixed size buffer which only
+/// it writes, so recording takes no locks. While tracing is stopped a span costs one relaxed atomic load,
+/// and defining AUDIO_TRACE_ENABLED as 0 compiles the trace macros out entirely.
+///
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef AUDIO_TRACE_ENABLED
+#define AUDIO_TRACE_ENABLED 1
+#endif
+
+class AudioTrace {
+public:
+    // Events each thread can record per capture, later events are dropped
+    static const size_t EVENTS_PER_THREAD = 65536;
+
+    /**
+     * Starts a new capture, discarding the events of the previous one
+     */
+    static void start();
+
+    /**
+     * Stops recording. Events already recorded are kept until the next start()
+     */
+    static void stop();
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Writes the last capture as Chrome trace JSON. Call after stop(), while no thread is recording.
+     * @return false if the file couldn't be written
+     */
+    static bool writeChromeJson(const char* filePath);
+
+    /**
+     * Names the calling thread in the trace. The name must outlive the trace, e.g. a string literal
+     */
+    static void setThreadName(const char* name);
+
+    /**
+     * Records a span. The name must be a string literal (or otherwise outlive the trace).
+     * Prefer AUDIO_TRACE_SCOPE, which measures the span and is compiled out with tracing.
+     */
+    static void complete(const char* name, int64_t startNs, int64_t durationNs);
+
+    /**
+     * Records a point in time, e.g. a callback firing. The name must be a string literal.
+     */
+    static void instant(const char* name);
+
+    /**
+     * Nanoseconds on the clock trace events are timed with
+     */
+    static int64_t now();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+/**
+ * Records a span from its construction to the end of the enclosing scope
+ */
+class AudioTraceScope {
+public:
+    explicit AudioTraceScope(const char* name) : name(name), startNs(AudioTrace::isEnabled() ? AudioTrace::now() : -1) {}
+
+    ~AudioTraceScope() {
+        if (startNs >= 0)
+            AudioTrace::complete(name, startNs, AudioTrace::now() - startNs);
+    }
+
+    AudioTraceScope(const AudioTraceScope&) = delete;
+    AudioTraceScope& operator=(const AudioTraceScope&) = delete;
+
+private:
+    const char* name;
+    int64_t startNs;
+};
+
+#define AUDIO_TRACE_CONCAT_INNER(a, b) a##b
+#define AUDIO_TRACE_CONCAT(a, b) AUDIO_TRACE_CONCAT_INNER(a, b)
+
+#if AUDIO_TRACE_ENABLED
+// Traces the enclosing scope under the given name, which must be a string literal
+#define AUDIO_TRACE_SCOPE(name) AudioTraceScope AUDIO_TRACE_CONCAT(_audioTraceScope, __LINE__)(name)
+// Traces the enclosing function under its name
+#define AUDIO_TRACE_FUNCTION() AUDIO_TRACE_SCOPE(__func__)
+#define AUDIO_TRACE_INSTANT(name) do { if (AudioTrace::isEnabled()) AudioTrace::instant(name); } while (0)
+#else
+#define AUDIO_TRACE_SCOPE(name) ((void)0)
+#define AUDIO_TRACE_FUNCTION() ((void)0)
+#define AUDIO_TRACE_INSTANT(name) ((void)0)
+#endif
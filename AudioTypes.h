@@ -0,0 +1,56 @@
+#pragma once
+///
+/// @file AudioTypes.h
+///
+/// Handle and vector types shared by the AudioEngine's public API and its internal stores.
+///
+#include "SlotMap.h"
+
+// Handle types returned by the AudioEngine. See SlotMap.h
+struct SoundTag;
+struct VoiceTag;
+struct EventTag;
+struct EventInstanceTag;
+struct EmitterTag;
+struct ReverbZoneTag;
+struct OcclusionMeshTag;
+
+// Handle to a sound loaded with AudioEngine::loadSound()
+using SoundHandle = Handle<SoundTag>;
+
+// Handle to a sound which is playing back on an FMOD::Channel
+using VoiceHandle = Handle<VoiceTag>;
+
+// Handle to an FMOD Studio event loaded with AudioEngine::loadFMODStudioEvent()
+using EventHandle = Handle<EventTag>;
+
+// Handle to one playing instance of an event, started with AudioEngine::playEventInstance()
+using EventInstanceHandle = Handle<EventInstanceTag>;
+
+// Handle to an ambient emitter added with AudioEngine::addEmitter()
+using EmitterHandle = Handle<EmitterTag>;
+
+// Handle to a reverb zone added with AudioEngine::addReverbZone()
+using ReverbZoneHandle = Handle<ReverbZoneTag>;
+
+// Handle to occluding geometry added with AudioEngine::addOcclusionMesh()
+using OcclusionMeshHandle = Handle<OcclusionMeshTag>;
+
+/**
+ * Handle to a parameter of an event, resolved once with AudioEngine::getEventParameterHandle()
+ * so setting the parameter skips FMOD's parameter name lookup
+ */
+struct EventParameterHandle {
+    EventHandle event;
+    // index of the parameter in the event's description
+    uint32_t index = 0xFFFFFFFFu;
+
+    bool isValid() const { return event.isValid() && index != 0xFFFFFFFFu; }
+};
+
+/**
+ * Simple 3D vector used by the handle based API
+ */
+struct Vec3 {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+};
@@ -0,0 +1,166 @@
+///
+/// @file EmitterRegistry.cpp
+///
+#include "EmitterRegistry.h"
+
+// Define EMITTER_REGISTRY_NO_SIMD to build the scalar path only, e.g. to compare against it
+#if defined(EMITTER_REGISTRY_NO_SIMD)
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define EMITTER_REGISTRY_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EMITTER_REGISTRY_SSE
+#endif
+
+EmitterHandle EmitterRegistry::add(const Emitter& emitter, Vec3 position, float maxDistance) {
+    EmitterHandle handle = emitters.insert(emitter);
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    maxDistanceSq.push_back(maxDistance * maxDistance);
+    cullDistanceSq.push_back(maxDistance * maxDistance);
+    active.push_back(0);
+    inRange.push_back(0);
+    grid.insert(handle.index, position);
+    return handle;
+}
+
+void EmitterRegistry::remove(EmitterHandle emitter) {
+    if (!emitters.contains(emitter))
+        return;
+    // mirror the swap with the last value that SlotMap::erase() does
+    size_t index = emitters.denseIndexOf(emitter);
+    size_t last = emitters.size() - 1;
+    positionX[index] = positionX[last];
+    positionY[index] = positionY[last];
+    positionZ[index] = positionZ[last];
+    maxDistanceSq[index] = maxDistanceSq[last];
+    cullDistanceSq[index] = cullDistanceSq[last];
+    active[index] = active[last];
+    inRange[index] = inRange[last];
+    positionX.pop_back();
+    positionY.pop_back();
+    positionZ.pop_back();
+    maxDistanceSq.pop_back();
+    cullDistanceSq.pop_back();
+    active.pop_back();
+    inRange.pop_back();
+    grid.remove(emitter.index);
+    emitters.erase(emitter);
+}
+
+void EmitterRegistry::setPosition(EmitterHandle emitter, Vec3 position) {
+    if (!emitters.contains(emitter))
+        return;
+    size_t index = emitters.denseIndexOf(emitter);
+    positionX[index] = position.x;
+    positionY[index] = position.y;
+    positionZ[index] = position.z;
+    grid.move(emitter.index, position);
+}
+
+void EmitterRegistry::setMaxDistance(EmitterHandle emitter, float maxDistance) {
+    if (!emitters.contains(emitter))
+        return;
+    size_t index = emitters.denseIndexOf(emitter);
+    maxDistanceSq[index] = maxDistance * maxDistance;
+    setActive(index, active[index] != 0);
+}
+
+void EmitterRegistry::setActive(size_t index, bool isActive) {
+    active[index] = isActive ? 1 : 0;
+    cullDistanceSq[index] = maxDistanceSq[index] * (isActive ? HYSTERESIS * HYSTERESIS : 1.0f);
+}
+
+void EmitterRegistry::queryRadius(Vec3 center, float radius, std::vector<EmitterHandle>& results) {
+    queryResults.clear();
+    grid.queryRadius(center, radius, queryResults);
+    for (uint32_t slot : queryResults)
+        results.push_back(emitters.handleForIndex(slot));
+}
+
+Vec3 EmitterRegistry::getPosition(size_t index) const {
+    Vec3 position;
+    position.x = positionX[index];
+    position.y = positionY[index];
+    position.z = positionZ[index];
+    return position;
+}
+
+const char* EmitterRegistry::simdPath() {
+#if defined(EMITTER_REGISTRY_AVX)
+    return "AVX";
+#elif defined(EMITTER_REGISTRY_SSE)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+void EmitterRegistry::computeInRange(const Vec3* listeners, int listenerCount) {
+    size_t count = emitters.size();
+    const float* px = positionX.data();
+    const float* py = positionY.data();
+    const float* pz = positionZ.data();
+    const float* cull = cullDistanceSq.data();
+    uint8_t* result = inRange.data();
+    size_t i = 0;
+
+#if defined(EMITTER_REGISTRY_AVX)
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+        __m256 nearest = _mm256_set1_ps(3.402823e38f);
+        for (int l = 0; l < listenerCount; l++) {
+            __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(listeners[l].x));
+            __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(listeners[l].y));
+            __m256 dz = _mm256_sub_ps(z, _mm256_set1_ps(listeners[l].z));
+            __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            nearest = _mm256_min_ps(nearest, distanceSq);
+        }
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(nearest, _mm256_loadu_ps(cull + i), _CMP_LE_OQ));
+        for (int lane = 0; lane < 8; lane++)
+            result[i + lane] = uint8_t((mask >> lane) & 1);
+    }
+#elif defined(EMITTER_REGISTRY_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+        __m128 nearest = _mm_set1_ps(3.402823e38f);
+        for (int l = 0; l < listenerCount; l++) {
+            __m128 dx = _mm_sub_ps(x, _mm_set1_ps(listeners[l].x));
+            __m128 dy = _mm_sub_ps(y, _mm_set1_ps(listeners[l].y));
+            __m128 dz = _mm_sub_ps(z, _mm_set1_ps(listeners[l].z));
+            __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            nearest = _mm_min_ps(nearest, distanceSq);
+        }
+        int mask = _mm_movemask_ps(_mm_cmple_ps(nearest, _mm_loadu_ps(cull + i)));
+        for (int lane = 0; lane < 4; lane++)
+            result[i + lane] = uint8_t((mask >> lane) & 1);
+    }
+#endif
+
+    // remaining emitters, or all of them without SIMD support
+    for (; i < count; i++) {
+        float nearest = 3.402823e38f;
+        for (int l = 0; l < listenerCount; l++) {
+            float dx = px[i] - listeners[l].x;
+            float dy = py[i] - listeners[l].y;
+            float dz = pz[i] - listeners[l].z;
+            float distanceSq = dx * dx + dy * dy + dz * dz;
+            nearest = distanceSq < nearest ? distanceSq : nearest;
+        }
+        result[i] = uint8_t(nearest <= cull[i]);
+    }
+}
+
+void EmitterRegistry::clear() {
+    emitters.clear();
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    maxDistanceSq.clear();
+    cullDistanceSq.clear();
+    active.clear();
+    inRange.clear();
+    grid.clear();
+}
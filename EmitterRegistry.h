@@ -0,0 +1,106 @@
+#pragma once
+///
+/// @file EmitterRegistry.h
+///
+/// Registry of persistent ambient emitters (e.g. waterfalls, machinery, crowds) which may number in the
+/// thousands per level. Each update the distance from the listener to every emitter is computed with SIMD
+/// over structure-of-arrays positions, and only emitters within their sound's max distance hold a voice.
+/// Emitters are also indexed in a SpatialGrid for radius queries around arbitrary positions.
+///
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AudioTypes.h"
+#include "SpatialGrid.h"
+
+class EmitterRegistry {
+public:
+    /**
+     * Per-emitter data which isn't needed by the distance pass
+     */
+    struct Emitter {
+        SoundHandle sound;
+        float volume = 1.0f;
+        float reverbAmount = 0.0f;
+        // voice playing the emitter's sound while it's in range
+        VoiceHandle voice;
+    };
+
+    // Emitters in range only leave it once they are this much further than their max distance,
+    // so an emitter sitting on the boundary doesn't start and stop its voice every frame
+    static constexpr float HYSTERESIS = 1.1f;
+
+    EmitterHandle add(const Emitter& emitter, Vec3 position, float maxDistance);
+
+    /**
+     * Removes an emitter. The caller is responsible for stopping its voice first.
+     */
+    void remove(EmitterHandle emitter);
+
+    Emitter* get(EmitterHandle emitter) { return emitters.get(emitter); }
+
+    void setPosition(EmitterHandle emitter, Vec3 position);
+
+    void setMaxDistance(EmitterHandle emitter, float maxDistance);
+
+    /**
+     * Computes which emitters are within range of the nearest of the listeners, writing the result to
+     * inRangeFlags(). Emitters already in range use their max distance widened by HYSTERESIS.
+     */
+    void computeInRange(const Vec3* listeners, int listenerCount);
+
+    /**
+     * Name of the instruction set computeInRange() was compiled for: "AVX", "SSE2" or "scalar"
+     */
+    static const char* simdPath();
+
+    /**
+     * Records whether an emitter is active (in range and holding a voice), which picks the cull distance
+     * that computeInRange() uses for it.
+     */
+    void setActive(size_t index, bool active);
+
+    /**
+     * Appends the handles of the emitters within radius of center to results, using the spatial grid
+     */
+    void queryRadius(Vec3 center, float radius, std::vector<EmitterHandle>& results);
+
+    bool isActive(size_t index) const { return active[index] != 0; }
+
+    // Result of the last computeInRange(), one flag per emitter in dense order
+    const uint8_t* inRangeFlags() const { return inRange.data(); }
+
+    // Dense access for iterating every emitter
+    size_t size() const { return emitters.size(); }
+    Emitter& operator[](size_t index) { return emitters[index]; }
+    EmitterHandle handleAt(size_t index) const { return emitters.handleAt(index); }
+    Vec3 getPosition(size_t index) const;
+
+    void clear();
+
+private:
+    SlotMap<Emitter, EmitterHandle> emitters;
+
+    // Emitter positions, in the same dense order as emitters
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+
+    // Squared max distance of each emitter's sound
+    std::vector<float> maxDistanceSq;
+
+    // Squared distance an emitter is culled beyond: maxDistanceSq, widened by HYSTERESIS while active
+    std::vector<float> cullDistanceSq;
+
+    // Whether each emitter currently holds a voice
+    std::vector<uint8_t> active;
+
+    // Output of computeInRange()
+    std::vector<uint8_t> inRange;
+
+    // Emitter positions keyed by handle slot index, which unlike the dense index is stable
+    SpatialGrid grid;
+
+    // Reused by queryRadius() so queries don't allocate
+    std::vector<uint32_t> queryResults;
+};
@@ -0,0 +1,177 @@
+#pragma once
+///
+/// @file EmitterStore.h
+///
+/// Structure-of-arrays storage for the 3D state of playing voices. Positions and velocities are kept in
+/// contiguous per-axis float arrays with a dirty flag per emitter, so moving many emitters is a handful of
+/// array writes, velocities are derived for every emitter in one vectorizable pass, and the AudioEngine
+/// pushes only the emitters that changed to FMOD, once per update().
+///
+#include <cstdint>
+#include <vector>
+#include "AudioTypes.h"
+
+class EmitterStore {
+public:
+    static const uint32_t NO_EMITTER = 0xFFFFFFFFu;
+
+    /**
+     * Adds an emitter owned by a voice. New emitters start dirty.
+     * @return index of the emitter, which changes if another emitter is removed (see remove())
+     */
+    uint32_t add(VoiceHandle voice, Vec3 position) {
+        uint32_t emitter = uint32_t(voices.size());
+        positionX.push_back(position.x);
+        positionY.push_back(position.y);
+        positionZ.push_back(position.z);
+        // no previous position yet, so the emitter starts at rest
+        previousX.push_back(position.x);
+        previousY.push_back(position.y);
+        previousZ.push_back(position.z);
+        velocityX.push_back(0.0f);
+        velocityY.push_back(0.0f);
+        velocityZ.push_back(0.0f);
+        dirty.push_back(1);
+        voices.push_back(voice);
+        return emitter;
+    }
+
+    /**
+     * Removes an emitter by moving the last emitter into its place
+     * @return the voice whose emitter moved to the removed index, or an invalid handle if none moved
+     */
+    VoiceHandle remove(uint32_t emitter) {
+        uint32_t last = uint32_t(voices.size() - 1);
+        VoiceHandle moved;
+        if (emitter != last) {
+            positionX[emitter] = positionX[last];
+            positionY[emitter] = positionY[last];
+            positionZ[emitter] = positionZ[last];
+            previousX[emitter] = previousX[last];
+            previousY[emitter] = previousY[last];
+            previousZ[emitter] = previousZ[last];
+            velocityX[emitter] = velocityX[last];
+            velocityY[emitter] = velocityY[last];
+            velocityZ[emitter] = velocityZ[last];
+            dirty[emitter] = dirty[last];
+            voices[emitter] = voices[last];
+            moved = voices[emitter];
+        }
+        positionX.pop_back();
+        positionY.pop_back();
+        positionZ.pop_back();
+        previousX.pop_back();
+        previousY.pop_back();
+        previousZ.pop_back();
+        velocityX.pop_back();
+        velocityY.pop_back();
+        velocityZ.pop_back();
+        dirty.pop_back();
+        voices.pop_back();
+        return moved;
+    }
+
+    void setPosition(uint32_t emitter, Vec3 position) {
+        positionX[emitter] = position.x;
+        positionY[emitter] = position.y;
+        positionZ[emitter] = position.z;
+        dirty[emitter] = 1;
+    }
+
+    Vec3 getPosition(uint32_t emitter) const {
+        Vec3 position;
+        position.x = positionX[emitter];
+        position.y = positionY[emitter];
+        position.z = positionZ[emitter];
+        return position;
+    }
+
+    Vec3 getVelocity(uint32_t emitter) const {
+        Vec3 velocity;
+        velocity.x = velocityX[emitter];
+        velocity.y = velocityY[emitter];
+        velocity.z = velocityZ[emitter];
+        return velocity;
+    }
+
+    /**
+     * Derives every emitter's velocity from how far it moved since the previous call, and marks emitters
+     * whose velocity changed as dirty (including ones which stopped moving, so FMOD sees them come to rest).
+     * Written as a single branch-free loop over the arrays so the compiler can vectorize it.
+     */
+    void deriveVelocities(float deltaSeconds) {
+        if (deltaSeconds <= 0.0f)
+            return;
+        float inverseDelta = 1.0f / deltaSeconds;
+        size_t count = voices.size();
+        float* px = positionX.data(); float* py = positionY.data(); float* pz = positionZ.data();
+        float* lx = previousX.data(); float* ly = previousY.data(); float* lz = previousZ.data();
+        float* vx = velocityX.data(); float* vy = velocityY.data(); float* vz = velocityZ.data();
+        uint8_t* changed = dirty.data();
+        for (size_t i = 0; i < count; i++) {
+            float newVX = (px[i] - lx[i]) * inverseDelta;
+            float newVY = (py[i] - ly[i]) * inverseDelta;
+            float newVZ = (pz[i] - lz[i]) * inverseDelta;
+            changed[i] |= uint8_t((newVX != vx[i]) | (newVY != vy[i]) | (newVZ != vz[i]));
+            vx[i] = newVX; vy[i] = newVY; vz[i] = newVZ;
+            lx[i] = px[i]; ly[i] = py[i]; lz[i] = pz[i];
+        }
+    }
+
+    bool isDirty(uint32_t emitter) const { return dirty[emitter] != 0; }
+
+    void clearDirty(uint32_t emitter) { dirty[emitter] = 0; }
+
+    VoiceHandle getVoice(uint32_t emitter) const { return voices[emitter]; }
+
+    void clear() {
+        positionX.clear();
+        positionY.clear();
+        positionZ.clear();
+        previousX.clear();
+        previousY.clear();
+        previousZ.clear();
+        velocityX.clear();
+        velocityY.clear();
+        velocityZ.clear();
+        dirty.clear();
+        voices.clear();
+    }
+
+    void reserve(size_t capacity) {
+        positionX.reserve(capacity);
+        positionY.reserve(capacity);
+        positionZ.reserve(capacity);
+        previousX.reserve(capacity);
+        previousY.reserve(capacity);
+        previousZ.reserve(capacity);
+        velocityX.reserve(capacity);
+        velocityY.reserve(capacity);
+        velocityZ.reserve(capacity);
+        dirty.reserve(capacity);
+        voices.reserve(capacity);
+    }
+
+    size_t size() const { return voices.size(); }
+
+private:
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+
+    // Positions at the previous deriveVelocities() call
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+    std::vector<float> previousZ;
+
+    // Velocities in units per second
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+
+    // Set when the emitter changed since it was last sent to FMOD
+    std::vector<uint8_t> dirty;
+
+    // Voice which owns each emitter
+    std::vector<VoiceHandle> voices;
+};
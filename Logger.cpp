@@ -0,0 +1,80 @@
+///
+/// @file Logger.cpp
+///
+#include "Logger.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+// How long the flush thread sleeps when the queue is empty
+const std::chrono::milliseconds FLUSH_INTERVAL(5);
+
+const char* levelPrefix(LogLevel level) {
+    switch (level) {
+    case LogLevel::Debug: return "[debug] ";
+    case LogLevel::Warning: return "[warning] ";
+    case LogLevel::Error: return "[error] ";
+    default: return "";
+    }
+}
+
+}
+
+Logger& Logger::get() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+void Logger::start() {
+    if (running.exchange(true))
+        return;
+    thread = std::thread(&Logger::run, this);
+}
+
+void Logger::stop() {
+    if (running.exchange(false))
+        thread.join();
+    flush();
+}
+
+void Logger::write(LogLevel level, const char* format, ...) {
+    Record record;
+    record.level = level;
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(record.message, sizeof(record.message), format, arguments);
+    va_end(arguments);
+    if (!records.push(record))
+        dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::run() {
+    while (running.load(std::memory_order_acquire)) {
+        flush();
+        std::this_thread::sleep_for(FLUSH_INTERVAL);
+    }
+}
+
+void Logger::flush() {
+    Record record;
+    bool wrote = false;
+    while (records.pop(record)) {
+        std::cout << levelPrefix(record.level) << record.message << '\n';
+        wrote = true;
+    }
+    unsigned long long droppedNow = dropped.load(std::memory_order_relaxed);
+    if (droppedNow != reportedDropped) {
+        std::cout << "[warning] Logger: Dropped " << droppedNow - reportedDropped << " messages, the log queue was full\n";
+        reportedDropped = droppedNow;
+        wrote = true;
+    }
+    if (wrote)
+        std::cout.flush();
+}
@@ -0,0 +1,124 @@
+#pragma once
+///
+/// @file Logger.h
+///
+/// Asynchronous logger. A message is formatted into a fixed size record on the calling thread and pushed
+/// onto a lock-free MPSCQueue; a background thread writes queued records to the console. Logging from the
+/// game thread, or from FMOD's callback threads, never takes the iostream lock or waits on a slow console.
+/// Log statements below AUDIO_LOG_LEVEL are compiled out entirely, arguments included.
+///
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include "MPSCQueue.h"
+
+#define AUDIO_LOG_LEVEL_DEBUG 0
+#define AUDIO_LOG_LEVEL_INFO 1
+#define AUDIO_LOG_LEVEL_WARNING 2
+#define AUDIO_LOG_LEVEL_ERROR 3
+#define AUDIO_LOG_LEVEL_NONE 4
+
+// Minimum level of the log statements compiled in, define it before including this header (or on the
+// compiler command line) to override. Debug messages are only compiled into debug builds by default.
+#ifndef AUDIO_LOG_LEVEL
+#ifdef NDEBUG
+#define AUDIO_LOG_LEVEL AUDIO_LOG_LEVEL_INFO
+#else
+#define AUDIO_LOG_LEVEL AUDIO_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AUDIO_LOG_PRINTF_FORMAT(formatIndex, firstArgument) __attribute__((format(printf, formatIndex, firstArgument)))
+#else
+#define AUDIO_LOG_PRINTF_FORMAT(formatIndex, firstArgument)
+#endif
+
+enum class LogLevel : uint8_t {
+    Debug = AUDIO_LOG_LEVEL_DEBUG,
+    Info = AUDIO_LOG_LEVEL_INFO,
+    Warning = AUDIO_LOG_LEVEL_WARNING,
+    Error = AUDIO_LOG_LEVEL_ERROR
+};
+
+class Logger {
+public:
+    // Longer messages are truncated
+    static const size_t MAX_MESSAGE_LENGTH = 255;
+    static const size_t QUEUE_CAPACITY = 1024;
+
+    /**
+     * The process-wide logger
+     */
+    static Logger& get();
+
+    ~Logger();
+
+    /**
+     * Starts the thread which writes queued messages to the console. Messages logged before this are
+     * queued and written once it starts.
+     */
+    void start();
+
+    /**
+     * Stops the flush thread, then writes any messages still queued
+     */
+    void stop();
+
+    /**
+     * Formats a message printf style and queues it. Safe to call from any thread, never blocks.
+     * If the queue is full the message is dropped and counted in getDroppedCount().
+     * Prefer the AUDIO_LOG_* macros, which compile out messages below AUDIO_LOG_LEVEL.
+     */
+    void write(LogLevel level, const char* format, ...) AUDIO_LOG_PRINTF_FORMAT(3, 4);
+
+    /**
+     * Number of messages dropped because the queue was full
+     */
+    unsigned long long getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Record {
+        LogLevel level = LogLevel::Info;
+        char message[MAX_MESSAGE_LENGTH + 1];
+    };
+
+    Logger() : records(QUEUE_CAPACITY) {}
+
+    void run();
+
+    // Writes every queued record, only called from the flush thread, or once it has stopped
+    void flush();
+
+    MPSCQueue<Record> records;
+    std::thread thread;
+    std::atomic<bool> running { false };
+    std::atomic<unsigned long long> dropped { 0 };
+    // dropped count at the last flush, so the flush thread reports new drops once
+    unsigned long long reportedDropped = 0;
+};
+
+#if AUDIO_LOG_LEVEL <= AUDIO_LOG_LEVEL_DEBUG
+#define AUDIO_LOG_DEBUG(...) Logger::get().write(LogLevel::Debug, __VA_ARGS__)
+#else
+#define AUDIO_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if AUDIO_LOG_LEVEL <= AUDIO_LOG_LEVEL_INFO
+#define AUDIO_LOG_INFO(...) Logger::get().write(LogLevel::Info, __VA_ARGS__)
+#else
+#define AUDIO_LOG_INFO(...) ((void)0)
+#endif
+
+#if AUDIO_LOG_LEVEL <= AUDIO_LOG_LEVEL_WARNING
+#define AUDIO_LOG_WARNING(...) Logger::get().write(LogLevel::Warning, __VA_ARGS__)
+#else
+#define AUDIO_LOG_WARNING(...) ((void)0)
+#endif
+
+#if AUDIO_LOG_LEVEL <= AUDIO_LOG_LEVEL_ERROR
+#define AUDIO_LOG_ERROR(...) Logger::get().write(LogLevel::Error, __VA_ARGS__)
+#else
+#define AUDIO_LOG_ERROR(...) ((void)0)
+#endif
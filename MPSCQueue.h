@@ -0,0 +1,96 @@
+#pragma once
+///
+/// @file MPSCQueue.h
+///
+/// Bounded lock-free multi-producer single-consumer queue. Any number of threads may push(), only one
+/// thread may pop(). Each cell carries a sequence number which tells producers and the consumer whether
+/// the cell is free to write or ready to read, so neither side ever takes a lock.
+///
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+template <typename T>
+class MPSCQueue {
+public:
+    /**
+     * @param capacity - maximum number of queued items, rounded up to a power of two
+     */
+    explicit MPSCQueue(size_t capacity = 4096) {
+        size_t roundedCapacity = 2;
+        while (roundedCapacity < capacity)
+            roundedCapacity <<= 1;
+        mask = roundedCapacity - 1;
+        cells.reset(new Cell[roundedCapacity]);
+        for (size_t i = 0; i < roundedCapacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    /**
+     * Adds an item to the queue. Safe to call from any thread.
+     * @return false if the queue is full and the item was dropped
+     */
+    bool push(const T& item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+            if (diff == 0) {
+                // the cell is free, try to claim it
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // the consumer hasn't freed this cell yet, so the queue is full
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+        Cell& cell = cells[pos & mask];
+        cell.item = item;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the oldest item from the queue. Must only be called from the consuming thread.
+     * @return false if the queue is empty
+     */
+    bool pop(T& item) {
+        Cell& cell = cells[dequeuePos & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (intptr_t(sequence) - intptr_t(dequeuePos + 1) < 0)
+            return false; // not written yet
+        item = cell.item;
+        cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+    /**
+     * Approximate number of queued items. Exact when called from the consuming thread with no producers active.
+     */
+    size_t sizeApprox() const {
+        size_t enqueued = enqueuePos.load(std::memory_order_relaxed);
+        return enqueued > dequeuePos ? enqueued - dequeuePos : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+
+    // Producers and the consumer write different positions, keep them on separate cache lines
+    alignas(64) std::atomic<size_t> enqueuePos { 0 };
+    alignas(64) size_t dequeuePos = 0;
+};
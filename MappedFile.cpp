@@ -0,0 +1,95 @@
+///
+/// @file MappedFile.cpp
+///
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* filePath) {
+    close();
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    mappedData = static_cast<const unsigned char*>(view);
+    mappedSize = size_t(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData)
+        UnmapViewOfFile(mappedData);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+    mappedData = nullptr;
+    mappedSize = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* filePath) {
+    close();
+    int fd = ::open(filePath, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file referenced
+    if (view == MAP_FAILED)
+        return false;
+    mappedData = static_cast<const unsigned char*>(view);
+    mappedSize = size_t(fileStat.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData)
+        munmap(const_cast<unsigned char*>(mappedData), mappedSize);
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+#endif
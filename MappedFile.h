@@ -0,0 +1,46 @@
+#pragma once
+///
+/// @file MappedFile.h
+///
+/// Read-only memory mapping of a file. Reading from the mapping pages the file in on demand,
+/// without a read syscall or a copy into an intermediate buffer.
+///
+#include <cstddef>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Maps the whole file into memory, closing any file that was previously mapped.
+     * @return false if the file couldn't be opened or mapped
+     */
+    bool open(const char* filePath);
+
+    /**
+     * Unmaps the file. Pointers previously returned by data() become invalid
+     */
+    void close();
+
+    bool isOpen() const { return mappedData != nullptr; }
+
+    // Start of the mapped file
+    const unsigned char* data() const { return mappedData; }
+
+    // Size of the mapped file in bytes
+    size_t size() const { return mappedSize; }
+
+private:
+    const unsigned char* mappedData = nullptr;
+    size_t mappedSize = 0;
+
+#ifdef _WIN32
+    // Win32 HANDLEs, kept as void* so windows.h isn't pulled into every includer
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
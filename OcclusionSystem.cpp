@@ -0,0 +1,284 @@
+///
+/// @file OcclusionSystem.cpp
+///
+#include "OcclusionSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "AudioTrace.h"
+
+namespace {
+
+Vec3 subtract(Vec3 a, Vec3 b) {
+    Vec3 result;
+    result.x = a.x - b.x;
+    result.y = a.y - b.y;
+    result.z = a.z - b.z;
+    return result;
+}
+
+Vec3 cross(Vec3 a, Vec3 b) {
+    Vec3 result;
+    result.x = a.y * b.z - a.z * b.y;
+    result.y = a.z * b.x - a.x * b.z;
+    result.z = a.x * b.y - a.y * b.x;
+    return result;
+}
+
+float dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float axis(Vec3 v, int index) {
+    return index == 0 ? v.x : index == 1 ? v.y : v.z;
+}
+
+/**
+ * Checks if the segment start + t * direction, 0 <= t <= 1, crosses a box
+ */
+bool segmentHitsBox(Vec3 start, Vec3 inverseDirection, Vec3 boundsMin, Vec3 boundsMax) {
+    float tMin = 0.0f, tMax = 1.0f;
+    for (int i = 0; i < 3; i++) {
+        float t0 = (axis(boundsMin, i) - axis(start, i)) * axis(inverseDirection, i);
+        float t1 = (axis(boundsMax, i) - axis(start, i)) * axis(inverseDirection, i);
+        if (t0 > t1)
+            std::swap(t0, t1);
+        // written so a NaN (segment lying in a slab plane) leaves the interval unchanged
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+        if (tMin > tMax)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Moller-Trumbore intersection of the segment start + t * direction, 0 <= t <= 1, with a triangle
+ */
+bool segmentHitsTriangle(Vec3 start, Vec3 direction, Vec3 a, Vec3 b, Vec3 c) {
+    const float epsilon = 1e-7f;
+    Vec3 edge1 = subtract(b, a);
+    Vec3 edge2 = subtract(c, a);
+    Vec3 p = cross(direction, edge2);
+    float determinant = dot(edge1, p);
+    if (std::fabs(determinant) < epsilon)
+        return false; // parallel to the triangle
+    float inverseDeterminant = 1.0f / determinant;
+    Vec3 s = subtract(start, a);
+    float u = dot(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    Vec3 q = cross(s, edge1);
+    float v = dot(direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    float t = dot(edge2, q) * inverseDeterminant;
+    return t >= 0.0f && t <= 1.0f;
+}
+
+}
+
+void OcclusionBVH::build(const std::vector<std::shared_ptr<const OcclusionMesh>>& meshes) {
+    triangles.clear();
+    nodes.clear();
+    for (const std::shared_ptr<const OcclusionMesh>& mesh : meshes) {
+        for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3) {
+            Triangle triangle;
+            triangle.a = mesh->vertices[mesh->indices[i]];
+            triangle.b = mesh->vertices[mesh->indices[i + 1]];
+            triangle.c = mesh->vertices[mesh->indices[i + 2]];
+            triangle.directOcclusion = mesh->directOcclusion;
+            triangle.reverbOcclusion = mesh->reverbOcclusion;
+            triangles.push_back(triangle);
+        }
+    }
+    if (triangles.empty())
+        return;
+    std::vector<Vec3> centroids(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        centroids[i].x = (triangles[i].a.x + triangles[i].b.x + triangles[i].c.x) / 3.0f;
+        centroids[i].y = (triangles[i].a.y + triangles[i].b.y + triangles[i].c.y) / 3.0f;
+        centroids[i].z = (triangles[i].a.z + triangles[i].b.z + triangles[i].c.z) / 3.0f;
+    }
+    nodes.reserve(2 * triangles.size() / MAX_LEAF_TRIANGLES + 1);
+    nodes.push_back(Node());
+    buildNode(0, 0, uint32_t(triangles.size()), centroids);
+}
+
+void OcclusionBVH::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, std::vector<Vec3>& centroids) {
+    Vec3 boundsMin = triangles[first].a, boundsMax = triangles[first].a;
+    Vec3 centroidMin = centroids[first], centroidMax = centroids[first];
+    for (uint32_t i = first; i < first + count; i++) {
+        for (const Vec3& vertex : { triangles[i].a, triangles[i].b, triangles[i].c }) {
+            boundsMin.x = std::min(boundsMin.x, vertex.x); boundsMax.x = std::max(boundsMax.x, vertex.x);
+            boundsMin.y = std::min(boundsMin.y, vertex.y); boundsMax.y = std::max(boundsMax.y, vertex.y);
+            boundsMin.z = std::min(boundsMin.z, vertex.z); boundsMax.z = std::max(boundsMax.z, vertex.z);
+        }
+        centroidMin.x = std::min(centroidMin.x, centroids[i].x); centroidMax.x = std::max(centroidMax.x, centroids[i].x);
+        centroidMin.y = std::min(centroidMin.y, centroids[i].y); centroidMax.y = std::max(centroidMax.y, centroids[i].y);
+        centroidMin.z = std::min(centroidMin.z, centroids[i].z); centroidMax.z = std::max(centroidMax.z, centroids[i].z);
+    }
+    nodes[nodeIndex].boundsMin = boundsMin;
+    nodes[nodeIndex].boundsMax = boundsMax;
+
+    Vec3 extent = subtract(centroidMax, centroidMin);
+    if (count <= MAX_LEAF_TRIANGLES || (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f)) {
+        nodes[nodeIndex].first = first;
+        nodes[nodeIndex].count = count;
+        return;
+    }
+
+    // split at the median centroid along the longest axis, reordering triangles and centroids together
+    int splitAxis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; i++)
+        order[i] = first + i;
+    uint32_t half = count / 2;
+    std::nth_element(order.begin(), order.begin() + half, order.end(), [&](uint32_t a, uint32_t b) {
+        return axis(centroids[a], splitAxis) < axis(centroids[b], splitAxis);
+    });
+    std::vector<Triangle> sortedTriangles(count);
+    std::vector<Vec3> sortedCentroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        sortedTriangles[i] = triangles[order[i]];
+        sortedCentroids[i] = centroids[order[i]];
+    }
+    std::copy(sortedTriangles.begin(), sortedTriangles.end(), triangles.begin() + first);
+    std::copy(sortedCentroids.begin(), sortedCentroids.end(), centroids.begin() + first);
+
+    // siblings are allocated together so an inner node only needs the index of its first child
+    uint32_t left = uint32_t(nodes.size());
+    nodes[nodeIndex].first = left;
+    nodes[nodeIndex].count = 0;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    buildNode(left, first, half, centroids);
+    buildNode(left + 1, first + half, count - half, centroids);
+}
+
+void OcclusionBVH::occlusion(Vec3 start, Vec3 end, float* direct, float* reverb) const {
+    float directOpen = 1.0f, reverbOpen = 1.0f;
+    Vec3 direction = subtract(end, start);
+    Vec3 inverseDirection;
+    inverseDirection.x = 1.0f / direction.x;
+    inverseDirection.y = 1.0f / direction.y;
+    inverseDirection.z = 1.0f / direction.z;
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    if (!nodes.empty())
+        stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        if (!segmentHitsBox(start, inverseDirection, node.boundsMin, node.boundsMax))
+            continue;
+        if (node.count == 0) {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            const Triangle& triangle = triangles[i];
+            if (segmentHitsTriangle(start, direction, triangle.a, triangle.b, triangle.c)) {
+                directOpen *= 1.0f - triangle.directOcclusion;
+                reverbOpen *= 1.0f - triangle.reverbOcclusion;
+            }
+        }
+    }
+    *direct = 1.0f - directOpen;
+    *reverb = 1.0f - reverbOpen;
+}
+
+OcclusionSystem::OcclusionSystem() : meshes(), pendingScene(), requests(QUEUE_CAPACITY), results(QUEUE_CAPACITY) {}
+
+OcclusionSystem::~OcclusionSystem() {
+    stop();
+}
+
+void OcclusionSystem::start() {
+    if (running)
+        return;
+    running = true;
+    worker = std::thread(&OcclusionSystem::workerLoop, this);
+}
+
+void OcclusionSystem::stop() {
+    if (running) {
+        running = false;
+        wake.notify_one();
+        worker.join();
+    }
+    // the worker has exited, so this thread can act as the requests queue's consumer
+    Request request;
+    while (requests.pop(request)) {}
+    Result result;
+    while (results.pop(result)) {}
+    meshes.clear();
+    meshesChanged = false;
+    std::lock_guard<std::mutex> lock(sceneMutex);
+    pendingScene.reset();
+}
+
+OcclusionMeshHandle OcclusionSystem::addMesh(const OcclusionMesh& mesh) {
+    meshesChanged = true;
+    return meshes.insert(std::make_shared<const OcclusionMesh>(mesh));
+}
+
+void OcclusionSystem::removeMesh(OcclusionMeshHandle mesh) {
+    if (!meshes.contains(mesh))
+        return;
+    meshes.erase(mesh);
+    meshesChanged = true;
+}
+
+void OcclusionSystem::publishMeshes() {
+    if (!meshesChanged)
+        return;
+    // meshes are immutable and shared, so the worker's copy of the set is only a list of pointers
+    auto scene = std::make_shared<std::vector<std::shared_ptr<const OcclusionMesh>>>(meshes.begin(), meshes.end());
+    {
+        std::lock_guard<std::mutex> lock(sceneMutex);
+        pendingScene = scene;
+    }
+    meshesChanged = false;
+    wake.notify_one();
+}
+
+bool OcclusionSystem::request(const Request& request) {
+    if (!requests.push(request))
+        return false;
+    wake.notify_one();
+    return true;
+}
+
+void OcclusionSystem::workerLoop() {
+    AudioTrace::setThreadName("Audio occlusion");
+    OcclusionBVH bvh;
+    while (running) {
+        std::shared_ptr<std::vector<std::shared_ptr<const OcclusionMesh>>> scene;
+        {
+            std::lock_guard<std::mutex> lock(sceneMutex);
+            scene.swap(pendingScene);
+        }
+        if (scene) {
+            AUDIO_TRACE_SCOPE("OcclusionBVH::build");
+            bvh.build(*scene);
+        }
+
+        bool worked = false;
+        Request request;
+        while (running && requests.pop(request)) {
+            Result result;
+            result.voice = request.voice;
+            bvh.occlusion(request.listener, request.emitter, &result.direct, &result.reverb);
+            // the audio thread drains results every update, wait for room rather than lose one
+            while (running && !results.push(result))
+                std::this_thread::yield();
+            worked = true;
+        }
+        if (!worked) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(5));
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+///
+/// @file OcclusionSystem.h
+///
+/// Geometry occlusion for 3D voices. Level geometry is added as triangle meshes, each with the direct and
+/// reverb occlusion a ray passing through one of its triangles picks up. A worker thread builds a bounding
+/// volume hierarchy over all the meshes and answers occlusion requests by casting a ray from the listener to
+/// each requested emitter. Requests and results travel through lock-free queues, so neither building the
+/// BVH nor casting rays ever blocks the thread calling AudioEngine::update().
+///
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "AudioTypes.h"
+#include "MPSCQueue.h"
+
+/**
+ * Immutable triangle mesh which occludes sound
+ */
+struct OcclusionMesh {
+    std::vector<Vec3> vertices;
+    // three vertex indices per triangle
+    std::vector<uint32_t> indices;
+    // 0 to 1, how much each triangle crossed attenuates the direct and reverb paths
+    float directOcclusion = 1.0f;
+    float reverbOcclusion = 1.0f;
+};
+
+/**
+ * Bounding volume hierarchy over the triangles of a set of meshes, built once and then only read
+ */
+class OcclusionBVH {
+public:
+    void build(const std::vector<std::shared_ptr<const OcclusionMesh>>& meshes);
+
+    /**
+     * Accumulates the occlusion of every triangle crossed by the segment from start to end. Occlusion combines
+     * multiplicatively, so crossing two triangles of 0.5 gives 1 - 0.5 * 0.5 = 0.75.
+     */
+    void occlusion(Vec3 start, Vec3 end, float* direct, float* reverb) const;
+
+    bool empty() const { return triangles.empty(); }
+
+private:
+    struct Triangle {
+        Vec3 a, b, c;
+        float directOcclusion;
+        float reverbOcclusion;
+    };
+
+    struct Node {
+        Vec3 boundsMin, boundsMax;
+        // leaves hold triangles [first, first + count), inner nodes have count 0 and children first, first + 1
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    static const uint32_t MAX_LEAF_TRIANGLES = 4;
+
+    /**
+     * Fills in a node covering triangles [first, first + count), splitting it until leaves are small enough
+     */
+    void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, std::vector<Vec3>& centroids);
+
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+class OcclusionSystem {
+public:
+    struct Request {
+        // VoiceHandle::toBits() of the voice the request is for
+        uint64_t voice = 0;
+        Vec3 listener;
+        Vec3 emitter;
+    };
+
+    struct Result {
+        uint64_t voice = 0;
+        float direct = 0.0f;
+        float reverb = 0.0f;
+    };
+
+    OcclusionSystem();
+    ~OcclusionSystem();
+
+    /**
+     * Starts the worker thread
+     */
+    void start();
+
+    /**
+     * Stops the worker thread, discarding queued requests, results and every mesh
+     */
+    void stop();
+
+    OcclusionMeshHandle addMesh(const OcclusionMesh& mesh);
+
+    void removeMesh(OcclusionMeshHandle mesh);
+
+    bool hasMeshes() const { return !meshes.empty(); }
+
+    /**
+     * Hands the current meshes to the worker if they changed since the last call, to be built into a new BVH.
+     * Called once per update() so adding many meshes in one frame only builds once.
+     */
+    void publishMeshes();
+
+    /**
+     * Queues an occlusion ray for the worker
+     * @return false if the request queue is full
+     */
+    bool request(const Request& request);
+
+    /**
+     * Takes the next finished result, if any
+     */
+    bool popResult(Result& result) { return results.pop(result); }
+
+private:
+    void workerLoop();
+
+    static const size_t QUEUE_CAPACITY = 4096;
+
+    SlotMap<std::shared_ptr<const OcclusionMesh>, OcclusionMeshHandle> meshes;
+    bool meshesChanged = false;
+
+    // Mesh set waiting for the worker to build, guarded by sceneMutex
+    std::shared_ptr<std::vector<std::shared_ptr<const OcclusionMesh>>> pendingScene;
+    std::mutex sceneMutex;
+
+    MPSCQueue<Request> requests;
+    MPSCQueue<Result> results;
+
+    std::thread worker;
+    std::atomic<bool> running { false };
+
+    // Wakes the worker when there's work, the worker also wakes periodically so a missed notify only delays it
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
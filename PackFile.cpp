@@ -0,0 +1,189 @@
+///
+/// @file PackFile.cpp
+///
+#include "PackFile.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+const char PACK_MAGIC[4] = { 'A', 'P', 'A', 'K' };
+const unsigned int PACK_VERSION = 1;
+
+/**
+ * A file opened through the PackFileSystem callbacks. Exactly one of data or diskFile is set.
+ */
+struct OpenFile {
+    // the file's data inside a pack's mapping
+    const unsigned char* data = nullptr;
+    unsigned int size = 0;
+    unsigned int position = 0;
+    // a loose file on the OS file system
+    FILE* diskFile = nullptr;
+};
+
+unsigned long long readLittleEndian(const unsigned char* bytes, int count) {
+    unsigned long long value = 0;
+    for (int i = count - 1; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+}
+
+std::string normalizePackPath(const char* path) {
+    std::string normalized(path);
+    for (char& c : normalized)
+        if (c == '\\')
+            c = '/';
+    return normalized;
+}
+
+bool PackFile::open(const char* filePath) {
+    if (!mappedFile.open(filePath))
+        return false;
+    path = normalizePackPath(filePath);
+    const unsigned char* data = mappedFile.data();
+    size_t size = mappedFile.size();
+
+    const size_t headerSize = 12;
+    if (size < headerSize || memcmp(data, PACK_MAGIC, 4) != 0 || readLittleEndian(data + 4, 4) != PACK_VERSION) {
+        mappedFile.close();
+        return false;
+    }
+    unsigned int entryCount = static_cast<unsigned int>(readLittleEndian(data + 8, 4));
+    entries.reserve(entryCount);
+
+    size_t cursor = headerSize;
+    for (unsigned int i = 0; i < entryCount; i++) {
+        if (cursor + 18 > size)
+            break;
+        Entry entry;
+        entry.offset = readLittleEndian(data + cursor, 8);
+        unsigned long long entrySize = readLittleEndian(data + cursor + 8, 8);
+        size_t nameLength = size_t(readLittleEndian(data + cursor + 16, 2));
+        cursor += 18;
+        // FMOD addresses files with 32 bit sizes, reject entries which don't fit or lie outside the pack
+        if (cursor + nameLength > size || entrySize > 0xFFFFFFFFull || entry.offset > size || entrySize > size - entry.offset)
+            break;
+        entry.size = static_cast<unsigned int>(entrySize);
+        entries[std::string(reinterpret_cast<const char*>(data + cursor), nameLength)] = entry;
+        cursor += nameLength;
+    }
+    if (entries.size() != entryCount) { // truncated or corrupt index
+        entries.clear();
+        mappedFile.close();
+        return false;
+    }
+    return true;
+}
+
+const unsigned char* PackFile::find(const std::string& name, unsigned int* size) const {
+    auto it = entries.find(name);
+    if (it == entries.end())
+        return nullptr;
+    *size = it->second.size;
+    return mappedFile.data() + it->second.offset;
+}
+
+PackFileSystem* PackFileSystem::installed = nullptr;
+
+FMOD_RESULT PackFileSystem::install(FMOD::System* system) {
+    installed = this;
+    return system->setFileSystem(openCallback, closeCallback, readCallback, seekCallback, 0, 0, 2048);
+}
+
+bool PackFileSystem::mount(const char* filePath) {
+    std::unique_ptr<PackFile> pack(new PackFile());
+    if (!pack->open(filePath))
+        return false;
+    std::lock_guard<std::mutex> lock(packsMutex);
+    packs.push_back(std::move(pack));
+    return true;
+}
+
+void PackFileSystem::unmount(const char* filePath) {
+    std::string normalized = normalizePackPath(filePath);
+    std::lock_guard<std::mutex> lock(packsMutex);
+    for (auto it = packs.begin(); it != packs.end(); ++it) {
+        if ((*it)->getPath() == normalized) {
+            packs.erase(it);
+            return;
+        }
+    }
+}
+
+void PackFileSystem::unmountAll() {
+    std::lock_guard<std::mutex> lock(packsMutex);
+    packs.clear();
+}
+
+bool PackFileSystem::getFileSize(const char* name, unsigned long long* size) {
+    unsigned int packedSize = 0;
+    if (find(name, &packedSize)) {
+        *size = packedSize;
+        return true;
+    }
+    std::error_code error;
+    *size = std::filesystem::file_size(name, error);
+    return !error;
+}
+
+const unsigned char* PackFileSystem::find(const char* name, unsigned int* size) {
+    std::string normalized = normalizePackPath(name);
+    std::lock_guard<std::mutex> lock(packsMutex);
+    for (auto it = packs.rbegin(); it != packs.rend(); ++it)
+        if (const unsigned char* data = (*it)->find(normalized, size))
+            return data;
+    return nullptr;
+}
+
+FMOD_RESULT F_CALL PackFileSystem::openCallback(const char* name, unsigned int* filesize, void** handle, void* /*userdata*/) {
+    OpenFile* file = new OpenFile();
+    file->data = installed->find(name, &file->size);
+    if (!file->data) {
+        file->diskFile = fopen(name, "rb");
+        if (!file->diskFile) {
+            delete file;
+            return FMOD_ERR_FILE_NOTFOUND;
+        }
+        fseek(file->diskFile, 0, SEEK_END);
+        file->size = static_cast<unsigned int>(ftell(file->diskFile));
+        fseek(file->diskFile, 0, SEEK_SET);
+    }
+    *filesize = file->size;
+    *handle = file;
+    return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL PackFileSystem::closeCallback(void* handle, void* /*userdata*/) {
+    OpenFile* file = static_cast<OpenFile*>(handle);
+    if (file->diskFile)
+        fclose(file->diskFile);
+    delete file;
+    return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL PackFileSystem::readCallback(void* handle, void* buffer, unsigned int sizebytes, unsigned int* bytesread, void* /*userdata*/) {
+    OpenFile* file = static_cast<OpenFile*>(handle);
+    if (file->diskFile)
+        *bytesread = static_cast<unsigned int>(fread(buffer, 1, sizebytes, file->diskFile));
+    else {
+        unsigned int remaining = file->size - file->position;
+        *bytesread = sizebytes < remaining ? sizebytes : remaining;
+        memcpy(buffer, file->data + file->position, *bytesread);
+        file->position += *bytesread;
+    }
+    return *bytesread < sizebytes ? FMOD_ERR_FILE_EOF : FMOD_OK;
+}
+
+FMOD_RESULT F_CALL PackFileSystem::seekCallback(void* handle, unsigned int pos, void* /*userdata*/) {
+    OpenFile* file = static_cast<OpenFile*>(handle);
+    if (file->diskFile)
+        return fseek(file->diskFile, long(pos), SEEK_SET) == 0 ? FMOD_OK : FMOD_ERR_FILE_COULDNOTSEEK;
+    if (pos > file->size)
+        return FMOD_ERR_FILE_COULDNOTSEEK;
+    file->position = pos;
+    return FMOD_OK;
+}
@@ -0,0 +1,116 @@
+#pragma once
+///
+/// @file PackFile.h
+///
+/// Pack files bundle many audio files (and banks) into a single archive which is memory-mapped, so
+/// loading a file from a pack is a lookup rather than an open/seek/read/close on the OS file system.
+/// The engine opens sounds and banks found in a pack in place, pointing FMOD into the mapping
+/// (FMOD_OPENMEMORY_POINT, FMOD_STUDIO_LOAD_MEMORY_POINT) so nothing is copied. The file system
+/// callbacks serve whatever FMOD still opens by name: files on disk, and pack entries read that way,
+/// which are copied out of the mapping.
+///
+/// Pack file layout (little-endian):
+///     char[4]  magic "APAK"
+///     uint32   version (1)
+///     uint32   entry count
+///     entries: uint64 offset, uint64 size, uint16 name length, char[name length] name
+///     file data, at the offsets given by the entries (relative to the start of the pack)
+/// Entry names are the paths the files are loaded with, using '/' as the separator.
+///
+#include <FMOD/fmod.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+
+/**
+ * A single mounted pack file
+ */
+class PackFile {
+public:
+    /**
+     * Maps the pack file and reads its index
+     * @return false if the file couldn't be mapped or isn't a valid pack
+     */
+    bool open(const char* filePath);
+
+    /**
+     * Looks up a file in the pack
+     * @return pointer to the file's data inside the mapping, or nullptr if the pack doesn't contain it
+     */
+    const unsigned char* find(const std::string& name, unsigned int* size) const;
+
+    const std::string& getPath() const { return path; }
+
+private:
+    struct Entry {
+        unsigned long long offset = 0;
+        unsigned int size = 0;
+    };
+
+    MappedFile mappedFile;
+    std::string path;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+/**
+ * Mounted pack files, and an FMOD file system which serves files opened by name from them, falling
+ * back to the OS file system for files that aren't in any pack. Only one can be installed at a time.
+ */
+class PackFileSystem {
+public:
+    /**
+     * Installs the file system callbacks on the FMOD system
+     */
+    FMOD_RESULT install(FMOD::System* system);
+
+    /**
+     * Mounts a pack file. Files in later mounts take precedence over earlier ones.
+     * @return false if the pack couldn't be opened
+     */
+    bool mount(const char* filePath);
+
+    /**
+     * Unmounts a pack file. Sounds and banks loaded from it must have been released first
+     */
+    void unmount(const char* filePath);
+
+    /**
+     * Unmounts every pack file
+     */
+    void unmountAll();
+
+    /**
+     * Looks up the size of a file, in a mounted pack or on disk
+     * @return false if the file doesn't exist
+     */
+    bool getFileSize(const char* name, unsigned long long* size);
+
+    /**
+     * Looks up a file in the mounted packs, newest mount first
+     * @return pointer to the file's data inside its pack's mapping, valid until the pack is unmounted,
+     * or nullptr if no mounted pack contains the file
+     */
+    const unsigned char* find(const char* name, unsigned int* size);
+
+private:
+    static FMOD_RESULT F_CALL openCallback(const char* name, unsigned int* filesize, void** handle, void* userdata);
+    static FMOD_RESULT F_CALL closeCallback(void* handle, void* userdata);
+    static FMOD_RESULT F_CALL readCallback(void* handle, void* buffer, unsigned int sizebytes, unsigned int* bytesread, void* userdata);
+    static FMOD_RESULT F_CALL seekCallback(void* handle, unsigned int pos, void* userdata);
+
+    // The installed file system, FMOD only passes per-sound user data to the callbacks
+    static PackFileSystem* installed;
+
+    std::vector<std::unique_ptr<PackFile>> packs;
+
+    // FMOD opens files from its loader and stream threads, guards packs against concurrent mounts
+    std::mutex packsMutex;
+};
+
+/**
+ * Converts a path to the form used for pack entry names
+ */
+std::string normalizePackPath(const char* path);
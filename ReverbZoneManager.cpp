@@ -0,0 +1,170 @@
+///
+/// @file ReverbZoneManager.cpp
+///
+#include "ReverbZoneManager.h"
+#include <algorithm>
+#include "AudioErrors.h"
+
+ReverbZoneManager::ReverbZoneManager() : zones(), grid(), pool(), queryResults(), candidates() {}
+
+void ReverbZoneManager::init(FMOD::System* system, int maxActive) {
+    this->system = system;
+    setMaxActive(maxActive);
+}
+
+void ReverbZoneManager::release() {
+    for (Zone& zone : zones)
+        if (zone.reverb)
+            ERRCHECK(zone.reverb->release());
+    for (FMOD::Reverb3D* reverb : pool)
+        ERRCHECK(reverb->release());
+    zones.clear();
+    grid.clear();
+    pool.clear();
+    largestMaxDistance = 0.0f;
+    system = nullptr;
+}
+
+ReverbZoneHandle ReverbZoneManager::add(const FMOD_REVERB_PROPERTIES& properties, Vec3 position, float minDistance, float maxDistance) {
+    Zone zone;
+    zone.properties = properties;
+    zone.position = position;
+    zone.minDistance = minDistance;
+    zone.maxDistance = maxDistance;
+    ReverbZoneHandle handle = zones.insert(zone);
+    grid.insert(handle.index, position);
+    largestMaxDistance = std::max(largestMaxDistance, maxDistance);
+    return handle;
+}
+
+void ReverbZoneManager::remove(ReverbZoneHandle handle) {
+    Zone* zone = zones.get(handle);
+    if (!zone)
+        return;
+    bool wasLargest = zone->maxDistance >= largestMaxDistance;
+    if (zone->reverb)
+        deactivate(*zone);
+    grid.remove(handle.index);
+    zones.erase(handle);
+    if (wasLargest) {
+        largestMaxDistance = 0.0f;
+        for (const Zone& other : zones)
+            largestMaxDistance = std::max(largestMaxDistance, other.maxDistance);
+    }
+}
+
+void ReverbZoneManager::setPosition(ReverbZoneHandle handle, Vec3 position) {
+    Zone* zone = zones.get(handle);
+    if (!zone)
+        return;
+    zone->position = position;
+    grid.move(handle.index, position);
+    if (zone->reverb)
+        applyAttributes(*zone);
+}
+
+void ReverbZoneManager::setProperties(ReverbZoneHandle handle, const FMOD_REVERB_PROPERTIES& properties) {
+    Zone* zone = zones.get(handle);
+    if (!zone)
+        return;
+    zone->properties = properties;
+    if (zone->reverb)
+        ERRCHECK(zone->reverb->setProperties(&zone->properties));
+}
+
+void ReverbZoneManager::setDistances(ReverbZoneHandle handle, float minDistance, float maxDistance) {
+    Zone* zone = zones.get(handle);
+    if (!zone)
+        return;
+    bool wasLargest = zone->maxDistance >= largestMaxDistance;
+    zone->minDistance = minDistance;
+    zone->maxDistance = maxDistance;
+    if (wasLargest && maxDistance < largestMaxDistance) {
+        largestMaxDistance = 0.0f;
+        for (const Zone& other : zones)
+            largestMaxDistance = std::max(largestMaxDistance, other.maxDistance);
+    }
+    largestMaxDistance = std::max(largestMaxDistance, maxDistance);
+    if (zone->reverb)
+        applyAttributes(*zone);
+}
+
+void ReverbZoneManager::setMaxActive(int maxActive) {
+    this->maxActive = std::max(maxActive, 0);
+    candidates.reserve(size_t(this->maxActive));
+}
+
+bool ReverbZoneManager::isActive(ReverbZoneHandle handle) const {
+    const Zone* zone = zones.get(handle);
+    return zone && zone->reverb;
+}
+
+void ReverbZoneManager::update(const Vec3* listeners, int listenerCount) {
+    // gather the zones near any listener, a zone near several listeners is found once per listener
+    queryResults.clear();
+    for (int l = 0; l < listenerCount; l++)
+        grid.queryRadius(listeners[l], largestMaxDistance, queryResults);
+    std::sort(queryResults.begin(), queryResults.end());
+    queryResults.erase(std::unique(queryResults.begin(), queryResults.end()), queryResults.end());
+
+    // keep the zones which actually contain a listener, by distance to the nearest listener
+    candidates.clear();
+    for (uint32_t slot : queryResults) {
+        ReverbZoneHandle handle = zones.handleForIndex(slot);
+        const Zone* zone = zones.get(handle);
+        float nearest = -1.0f;
+        for (int l = 0; l < listenerCount; l++) {
+            float dx = zone->position.x - listeners[l].x;
+            float dy = zone->position.y - listeners[l].y;
+            float dz = zone->position.z - listeners[l].z;
+            float distanceSq = dx * dx + dy * dy + dz * dz;
+            if (nearest < 0.0f || distanceSq < nearest)
+                nearest = distanceSq;
+        }
+        if (nearest <= zone->maxDistance * zone->maxDistance)
+            candidates.push_back({ handle, nearest });
+    }
+    size_t activeCount = std::min(candidates.size(), size_t(maxActive));
+    auto byDistance = [](const Candidate& a, const Candidate& b) { return a.distanceSq < b.distanceSq; };
+    std::nth_element(candidates.begin(), candidates.begin() + activeCount, candidates.end(), byDistance);
+
+    // free the reverbs of zones which dropped out before handing them to zones which came in
+    for (size_t i = 0; i < activeCount; i++)
+        zones.get(candidates[i].zone)->selected = true;
+    for (Zone& zone : zones) {
+        if (zone.reverb && !zone.selected)
+            deactivate(zone);
+    }
+    for (size_t i = 0; i < activeCount; i++) {
+        Zone* zone = zones.get(candidates[i].zone);
+        zone->selected = false;
+        if (!zone->reverb)
+            activate(*zone);
+    }
+}
+
+void ReverbZoneManager::activate(Zone& zone) {
+    if (pool.empty()) {
+        FMOD::Reverb3D* reverb = nullptr;
+        ERRCHECK(system->createReverb3D(&reverb));
+        if (!reverb)
+            return;
+        pool.push_back(reverb);
+    }
+    zone.reverb = pool.back();
+    pool.pop_back();
+    ERRCHECK(zone.reverb->setProperties(&zone.properties));
+    applyAttributes(zone);
+    ERRCHECK(zone.reverb->setActive(true));
+}
+
+void ReverbZoneManager::deactivate(Zone& zone) {
+    ERRCHECK(zone.reverb->setActive(false));
+    pool.push_back(zone.reverb);
+    zone.reverb = nullptr;
+}
+
+void ReverbZoneManager::applyAttributes(Zone& zone) {
+    FMOD_VECTOR position = { zone.position.x, zone.position.y, zone.position.z };
+    ERRCHECK(zone.reverb->set3DAttributes(&position, zone.minDistance, zone.maxDistance));
+}
@@ -0,0 +1,103 @@
+#pragma once
+///
+/// @file ReverbZoneManager.h
+///
+/// Manages any number of reverb zones (acoustic spaces such as caves, halls or tunnels) while only paying
+/// mixer cost for the few nearest the listener. Each zone has reverb properties, a position and min/max
+/// distances; only the maxActive nearest zones containing the listener are backed by real FMOD::Reverb3D
+/// objects, which are pooled and reassigned between zones as the listener moves.
+///
+#include <FMOD/fmod.hpp>
+#include <vector>
+#include "AudioTypes.h"
+#include "SpatialGrid.h"
+
+class ReverbZoneManager {
+public:
+    ReverbZoneManager();
+
+    /**
+     * Sets the system reverbs are created on and the number of zones which may be active at once
+     */
+    void init(FMOD::System* system, int maxActive);
+
+    /**
+     * Releases every zone and pooled reverb
+     */
+    void release();
+
+    ReverbZoneHandle add(const FMOD_REVERB_PROPERTIES& properties, Vec3 position, float minDistance, float maxDistance);
+
+    void remove(ReverbZoneHandle zone);
+
+    void setPosition(ReverbZoneHandle zone, Vec3 position);
+
+    void setProperties(ReverbZoneHandle zone, const FMOD_REVERB_PROPERTIES& properties);
+
+    void setDistances(ReverbZoneHandle zone, float minDistance, float maxDistance);
+
+    /**
+     * Changes how many zones may be backed by a real reverb at once, taking effect next update()
+     */
+    void setMaxActive(int maxActive);
+
+    /**
+     * Checks if a zone is currently backed by a real reverb
+     */
+    bool isActive(ReverbZoneHandle zone) const;
+
+    bool empty() const { return zones.empty(); }
+
+    /**
+     * Activates the nearest zones whose max distance contains one of the listeners, up to the active limit,
+     * and returns the reverbs of zones no longer among them to the pool
+     */
+    void update(const Vec3* listeners, int listenerCount);
+
+private:
+    struct Zone {
+        FMOD_REVERB_PROPERTIES properties;
+        Vec3 position;
+        float minDistance = 0.0f;
+        float maxDistance = 0.0f;
+        // real reverb while the zone is active, otherwise nullptr
+        FMOD::Reverb3D* reverb = nullptr;
+        // marks the zones chosen during update()
+        bool selected = false;
+    };
+
+    struct Candidate {
+        ReverbZoneHandle zone;
+        float distanceSq;
+    };
+
+    /**
+     * Takes a reverb from the pool, creating one if the pool is empty, and applies the zone's settings to it
+     */
+    void activate(Zone& zone);
+
+    /**
+     * Returns the zone's reverb to the pool
+     */
+    void deactivate(Zone& zone);
+
+    void applyAttributes(Zone& zone);
+
+    FMOD::System* system = nullptr;
+    int maxActive = 4;
+
+    SlotMap<Zone, ReverbZoneHandle> zones;
+
+    // Zone positions keyed by handle slot index
+    SpatialGrid grid;
+
+    // Largest max distance of any zone, the radius zones are searched for around each listener
+    float largestMaxDistance = 0.0f;
+
+    // Inactive reverbs, kept so activating a zone doesn't create a DSP
+    std::vector<FMOD::Reverb3D*> pool;
+
+    // Reused by update() so it doesn't allocate
+    std::vector<uint32_t> queryResults;
+    std::vector<Candidate> candidates;
+};
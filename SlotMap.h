@@ -0,0 +1,210 @@
+#pragma once
+///
+/// @file SlotMap.h
+///
+/// Dense generational slot map used by the AudioEngine to hand out handles to sounds, voices and events.
+/// Lookups are an index plus a generation compare, so a stale handle (one whose object has since been
+/// removed) is detected instead of silently aliasing whatever now occupies the slot.
+///
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Opaque handle to an object stored in a SlotMap. The Tag parameter only exists to make handles to
+ * different kinds of objects distinct types, so a VoiceHandle can't be passed where a SoundHandle is expected.
+ */
+template <typename Tag>
+struct Handle {
+    static const uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+
+    /**
+     * Returns true if the handle was ever assigned. This does not mean the object is still alive,
+     * use the owning SlotMap's contains() for that.
+     */
+    bool isValid() const { return index != INVALID_INDEX; }
+
+    /**
+     * Packs the handle into a single 64 bit value, e.g. for storing in FMOD user data
+     */
+    uint64_t toBits() const { return (uint64_t(generation) << 32) | index; }
+
+    /**
+     * Unpacks a handle previously packed with toBits()
+     */
+    static Handle fromBits(uint64_t bits) {
+        Handle handle;
+        handle.index = uint32_t(bits & 0xFFFFFFFFu);
+        handle.generation = uint32_t(bits >> 32);
+        return handle;
+    }
+
+    bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+/**
+ * Container which stores values contiguously and addresses them through generational handles.
+ * Insertion, lookup and removal are all O(1). Removal swaps the last value into the removed value's
+ * place, so pointers returned by get() are only valid until the next insert() or erase().
+ */
+template <typename T, typename HandleType>
+class SlotMap {
+public:
+    /**
+     * Adds a value to the map and returns the handle that addresses it
+     */
+    HandleType insert(T value) {
+        uint32_t slotIndex;
+        if (freeHead != NO_FREE_SLOT) {
+            slotIndex = freeHead;
+            freeHead = slots[slotIndex].nextFree;
+        }
+        else {
+            slotIndex = uint32_t(slots.size());
+            slots.push_back(Slot());
+        }
+        Slot& slot = slots[slotIndex];
+        slot.denseIndex = uint32_t(values.size());
+        values.push_back(std::move(value));
+        denseToSlot.push_back(slotIndex);
+
+        HandleType handle;
+        handle.index = slotIndex;
+        handle.generation = slot.generation;
+        return handle;
+    }
+
+    /**
+     * Removes the value addressed by the handle. Returns false if the handle is stale.
+     */
+    bool erase(HandleType handle) {
+        if (!contains(handle))
+            return false;
+        Slot& slot = slots[handle.index];
+        uint32_t removedDense = slot.denseIndex;
+        uint32_t lastDense = uint32_t(values.size() - 1);
+        if (removedDense != lastDense) {
+            values[removedDense] = std::move(values[lastDense]);
+            denseToSlot[removedDense] = denseToSlot[lastDense];
+            slots[denseToSlot[removedDense]].denseIndex = removedDense;
+        }
+        values.pop_back();
+        denseToSlot.pop_back();
+
+        // bumping the generation invalidates every outstanding handle to this slot
+        ++slot.generation;
+        slot.denseIndex = NO_FREE_SLOT;
+        slot.nextFree = freeHead;
+        freeHead = handle.index;
+        return true;
+    }
+
+    /**
+     * Checks if the handle still addresses a live value
+     */
+    bool contains(HandleType handle) const {
+        return handle.index < slots.size()
+            && slots[handle.index].generation == handle.generation
+            && slots[handle.index].denseIndex != NO_FREE_SLOT;
+    }
+
+    /**
+     * Returns a pointer to the value addressed by the handle, or nullptr if the handle is stale
+     */
+    T* get(HandleType handle) {
+        return contains(handle) ? &values[slots[handle.index].denseIndex] : nullptr;
+    }
+
+    const T* get(HandleType handle) const {
+        return contains(handle) ? &values[slots[handle.index].denseIndex] : nullptr;
+    }
+
+    /**
+     * Returns the dense index of the value addressed by a live handle. Containers which keep extra
+     * per-value arrays in dense order use it to mirror the swap done by erase()
+     */
+    size_t denseIndexOf(HandleType handle) const {
+        return slots[handle.index].denseIndex;
+    }
+
+    /**
+     * Returns the handle currently occupying a slot index, or an invalid handle if the slot is empty.
+     * Used when only the index was recorded, e.g. in FMOD user data; callers must confirm it's the same object.
+     */
+    HandleType handleForIndex(uint32_t index) const {
+        HandleType handle;
+        if (index < slots.size() && slots[index].denseIndex != NO_FREE_SLOT) {
+            handle.index = index;
+            handle.generation = slots[index].generation;
+        }
+        return handle;
+    }
+
+    /**
+     * Returns the handle of the value stored at a dense index, for use while iterating
+     */
+    HandleType handleAt(size_t denseIndex) const {
+        HandleType handle;
+        handle.index = denseToSlot[denseIndex];
+        handle.generation = slots[handle.index].generation;
+        return handle;
+    }
+
+    /**
+     * Removes all values and invalidates all handles
+     */
+    void clear() {
+        for (uint32_t i = 0; i < denseToSlot.size(); i++) {
+            Slot& slot = slots[denseToSlot[i]];
+            ++slot.generation;
+            slot.denseIndex = NO_FREE_SLOT;
+            slot.nextFree = freeHead;
+            freeHead = denseToSlot[i];
+        }
+        values.clear();
+        denseToSlot.clear();
+    }
+
+    void reserve(size_t capacity) {
+        slots.reserve(capacity);
+        values.reserve(capacity);
+        denseToSlot.reserve(capacity);
+    }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    // Dense iteration over the live values
+    T& operator[](size_t denseIndex) { return values[denseIndex]; }
+    const T& operator[](size_t denseIndex) const { return values[denseIndex]; }
+    typename std::vector<T>::iterator begin() { return values.begin(); }
+    typename std::vector<T>::iterator end() { return values.end(); }
+    typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+    typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+private:
+    static const uint32_t NO_FREE_SLOT = 0xFFFFFFFFu;
+
+    struct Slot {
+        uint32_t denseIndex = NO_FREE_SLOT;
+        uint32_t generation = 0;
+        uint32_t nextFree = NO_FREE_SLOT;
+    };
+
+    // Sparse slots which handles index into, each pointing at a value in the dense array
+    std::vector<Slot> slots;
+
+    // Live values, stored contiguously
+    std::vector<T> values;
+
+    // Maps each dense value back to its slot so removal can patch the swapped value's slot
+    std::vector<uint32_t> denseToSlot;
+
+    // Head of the intrusive list of unused slots
+    uint32_t freeHead = NO_FREE_SLOT;
+};
@@ -0,0 +1,129 @@
+///
+/// @file SpatialGrid.cpp
+///
+#include "SpatialGrid.h"
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float cellSize) : cellSize(cellSize), inverseCellSize(1.0f / cellSize) {
+}
+
+uint64_t SpatialGrid::cellKey(int32_t x, int32_t y, int32_t z) {
+    const uint64_t mask = (1ull << 21) - 1;
+    return (uint64_t(uint32_t(x)) & mask) | ((uint64_t(uint32_t(y)) & mask) << 21) | ((uint64_t(uint32_t(z)) & mask) << 42);
+}
+
+int32_t SpatialGrid::cellCoordinate(float position) const {
+    return int32_t(std::floor(position * inverseCellSize));
+}
+
+void SpatialGrid::insert(uint32_t id, Vec3 position) {
+    if (contains(id)) {
+        move(id, position);
+        return;
+    }
+    if (id >= points.size())
+        points.resize(size_t(id) + 1);
+    Point& point = points[id];
+    point.x = position.x;
+    point.y = position.y;
+    point.z = position.z;
+    point.cell = cellKey(cellCoordinate(position.x), cellCoordinate(position.y), cellCoordinate(position.z));
+    point.present = true;
+    addToBucket(id);
+    count++;
+}
+
+void SpatialGrid::move(uint32_t id, Vec3 position) {
+    if (!contains(id))
+        return;
+    Point& point = points[id];
+    point.x = position.x;
+    point.y = position.y;
+    point.z = position.z;
+    uint64_t cell = cellKey(cellCoordinate(position.x), cellCoordinate(position.y), cellCoordinate(position.z));
+    if (cell == point.cell)
+        return;
+    removeFromBucket(id);
+    point.cell = cell;
+    addToBucket(id);
+}
+
+void SpatialGrid::remove(uint32_t id) {
+    if (!contains(id))
+        return;
+    removeFromBucket(id);
+    points[id].present = false;
+    count--;
+}
+
+void SpatialGrid::addToBucket(uint32_t id) {
+    std::vector<uint32_t>& bucket = cells[points[id].cell];
+    points[id].bucketIndex = uint32_t(bucket.size());
+    bucket.push_back(id);
+}
+
+void SpatialGrid::removeFromBucket(uint32_t id) {
+    auto it = cells.find(points[id].cell);
+    std::vector<uint32_t>& bucket = it->second;
+    uint32_t index = points[id].bucketIndex;
+    bucket[index] = bucket.back();
+    points[bucket[index]].bucketIndex = index;
+    bucket.pop_back();
+    if (bucket.empty())
+        cells.erase(it);
+}
+
+size_t SpatialGrid::queryRadius(Vec3 center, float radius, std::vector<uint32_t>& results) const {
+    size_t found = results.size();
+    float radiusSq = radius * radius;
+    auto test = [&](const std::vector<uint32_t>& bucket) {
+        for (uint32_t id : bucket) {
+            const Point& point = points[id];
+            float dx = point.x - center.x;
+            float dy = point.y - center.y;
+            float dz = point.z - center.z;
+            if (dx * dx + dy * dy + dz * dz <= radiusSq)
+                results.push_back(id);
+        }
+    };
+
+    int32_t minX = cellCoordinate(center.x - radius), maxX = cellCoordinate(center.x + radius);
+    int32_t minY = cellCoordinate(center.y - radius), maxY = cellCoordinate(center.y + radius);
+    int32_t minZ = cellCoordinate(center.z - radius), maxZ = cellCoordinate(center.z + radius);
+    double cellsCovered = double(maxX - minX + 1) * double(maxY - minY + 1) * double(maxZ - minZ + 1);
+
+    if (cellsCovered > double(cells.size())) {
+        // the query covers more cells than are occupied, visiting the occupied ones is cheaper
+        for (const auto& cell : cells)
+            test(cell.second);
+    }
+    else {
+        for (int32_t z = minZ; z <= maxZ; z++)
+            for (int32_t y = minY; y <= maxY; y++)
+                for (int32_t x = minX; x <= maxX; x++) {
+                    auto it = cells.find(cellKey(x, y, z));
+                    if (it != cells.end())
+                        test(it->second);
+                }
+    }
+    return results.size() - found;
+}
+
+void SpatialGrid::setCellSize(float newCellSize) {
+    cellSize = newCellSize;
+    inverseCellSize = 1.0f / newCellSize;
+    cells.clear();
+    for (uint32_t id = 0; id < points.size(); id++) {
+        Point& point = points[id];
+        if (!point.present)
+            continue;
+        point.cell = cellKey(cellCoordinate(point.x), cellCoordinate(point.y), cellCoordinate(point.z));
+        addToBucket(id);
+    }
+}
+
+void SpatialGrid::clear() {
+    points.clear();
+    cells.clear();
+    count = 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+///
+/// @file SpatialGrid.h
+///
+/// Uniform spatial hash grid over points in 3D, used to answer "what is near this position" without
+/// scanning every emitter or zone. Points are bucketed by the cell they fall in; cells are hashed so only
+/// occupied cells take memory and the world has no fixed bounds. Moving a point within its cell only
+/// updates its position, crossing into another cell is a swap-remove from one bucket and a push onto another.
+///
+/// Points are identified by a caller chosen id which should be small and dense, e.g. the slot index of a
+/// SlotMap handle, as ids index directly into the grid's point table.
+///
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "AudioTypes.h"
+
+class SpatialGrid {
+public:
+    /**
+     * @param cellSize edge length of a cell, ideally close to the typical query radius
+     */
+    explicit SpatialGrid(float cellSize = 50.0f);
+
+    /**
+     * Adds a point, or moves it if the id is already present
+     */
+    void insert(uint32_t id, Vec3 position);
+
+    /**
+     * Moves a point, rebucketing it only if it crossed into another cell
+     */
+    void move(uint32_t id, Vec3 position);
+
+    void remove(uint32_t id);
+
+    bool contains(uint32_t id) const { return id < points.size() && points[id].present; }
+
+    /**
+     * Appends the ids of all points within radius of center to results (which isn't cleared first)
+     * @return the number of ids appended
+     */
+    size_t queryRadius(Vec3 center, float radius, std::vector<uint32_t>& results) const;
+
+    /**
+     * Changes the cell size, rebucketing every point
+     */
+    void setCellSize(float newCellSize);
+
+    float getCellSize() const { return cellSize; }
+
+    void clear();
+
+    size_t size() const { return count; }
+
+private:
+    struct Point {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        uint64_t cell = 0;
+        // position of the id in its cell's bucket
+        uint32_t bucketIndex = 0;
+        bool present = false;
+    };
+
+    /**
+     * Packs integer cell coordinates into a single key, 21 bits per axis
+     */
+    static uint64_t cellKey(int32_t x, int32_t y, int32_t z);
+
+    int32_t cellCoordinate(float position) const;
+
+    void addToBucket(uint32_t id);
+    void removeFromBucket(uint32_t id);
+
+    float cellSize;
+    float inverseCellSize;
+
+    // Indexed by id
+    std::vector<Point> points;
+    size_t count = 0;
+
+    // Ids of the points in each occupied cell
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+};